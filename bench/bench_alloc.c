@@ -0,0 +1,69 @@
+// Compare the slab pool allocator against per-node calloc/free
+//
+//   cc -O2 -pthread -I. bench/bench_alloc.c slm.c -o bench_pool
+//   cc -O2 -pthread -I. -DSLM_POOL=0 bench/bench_alloc.c slm.c -o bench_calloc
+//
+// Usage: bench_alloc [elements]
+
+#include "slm.h"
+#include <time.h>
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t nnz = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    const size_t m = nnz / 16 + 1;
+    const size_t n = nnz / 16 + 1;
+
+    double t0 = now();
+    slm_matrix_t *matrix = slm_matrix_new();
+    // Create every column up front, in order, so that the timings are not
+    // dominated by the column list scan in `slm_matrix_insert`
+    for (size_t l = 0; l < n; l++) {
+        slm_matrix_insert(matrix, 0, l);
+    }
+    for (size_t k = 1; k < m; k++) {
+        for (size_t l = 0; l < 16; l++) {
+            slm_matrix_insert(matrix, k, rng() % n);
+        }
+    }
+    double t1 = now();
+
+    // Churn: drop a tenth of the rows, then refill as many
+    for (size_t k = 0; k < m / 10; k++) {
+        slm_matrix_remove_row(matrix, 1 + rng() % (m - 1));
+    }
+    for (size_t k = 1; k < m; k += 10) {
+        for (size_t l = 0; l < 16; l++) {
+            slm_matrix_insert(matrix, k, rng() % n);
+        }
+    }
+    double t2 = now();
+
+    const size_t total = slm_total_elements(matrix);
+    slm_matrix_free(matrix);
+    double t3 = now();
+
+    printf("allocator: %s\n", SLM_POOL ? "pool" : "calloc");
+    printf("elements:  %zu\n", total);
+    printf("insert:    %.3f s (%.1f ns/op)\n", t1 - t0, (t1 - t0) * 1e9 / (double)(n + m * 16));
+    printf("churn:     %.3f s\n", t2 - t1);
+    printf("free:      %.3f s (%.1f ns/elem)\n", t3 - t2, (t3 - t2) * 1e9 / (double)total);
+    return 0;
+}
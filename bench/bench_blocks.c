@@ -0,0 +1,68 @@
+// Scaling of parallel block labeling from one thread up to N
+//
+//   cc -O2 -pthread -I. bench/bench_blocks.c slm.c -o bench_blocks
+//
+// Usage: bench_blocks [elements] [blocks] [max threads]
+
+#include "slm.h"
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t nnz = argc > 1 ? strtoull(argv[1], NULL, 10) : 8000000;
+    const size_t k = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t max_threads = argc > 3 ? strtoull(argv[3], NULL, 10) : (cpus > 0 ? (size_t)cpus : 1);
+
+    // `k` planted blocks of equal size, each a random sparse square
+    const size_t side = nnz / k / 8 + 1;
+    size_t *i = malloc(nnz * sizeof(size_t));
+    size_t *j = malloc(nnz * sizeof(size_t));
+    for (size_t e = 0; e < nnz; e++) {
+        const size_t b = rng() % k;
+        i[e] = b * side + rng() % side;
+        j[e] = b * side + rng() % side;
+    }
+    slm_matrix_t *matrix = slm_matrix_from_coo(i, j, nnz);
+    slm_frozen_t *frozen = slm_matrix_freeze(matrix);
+    free(i);
+    free(j);
+
+    printf("%zu rows, %zu cols, %zu elements\n", matrix->m, matrix->n, frozen->nnz);
+    printf("threads\tmatrix (s)\tfrozen (s)\tblocks\n");
+    for (size_t t = 1; t <= max_threads; t *= 2) {
+        double t0 = now();
+        slm_blocks_t *a = slm_matrix_blocks_parallel(matrix, t);
+        double t1 = now();
+        slm_blocks_t *b = slm_frozen_blocks_parallel(frozen, t);
+        double t2 = now();
+        printf("%zu\t%.4f\t\t%.4f\t\t%zu\n", t, t1 - t0, t2 - t1, b->count);
+        slm_blocks_free(a);
+        slm_blocks_free(b);
+        if ((t < max_threads) && (2 * t > max_threads)) {
+            t = max_threads / 2;
+        }
+    }
+
+    slm_frozen_free(frozen);
+    slm_matrix_free(matrix);
+    return 0;
+}
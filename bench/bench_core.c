@@ -0,0 +1,325 @@
+// Core operations over synthetic matrices, reported as JSON: one object per
+// generator and operation, each measured in a process of its own
+//
+//   make bench
+//
+// or, by hand, wrapping the allocator so that allocations can be counted:
+//
+//   cc -O2 -pthread -I. -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+//      bench/bench_core.c slm.c -lm -o bench_core
+//
+// Usage: bench_core [elements] [side] [blocks]
+
+#include "slm.h"
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t allocs;
+static size_t frees;
+
+void *__wrap_malloc(size_t size)
+{
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocs += !ptr;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    frees += !!ptr;
+    __real_free(ptr);
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Uniform draw from [0, 1)
+static double uniform(void)
+{
+    return (double)(rng() >> 11) * 0x1p-53;
+}
+
+typedef struct bench_coo_t {
+    size_t *i;
+    size_t *j;
+    size_t nnz;
+} bench_coo_t;
+
+typedef void (*bench_gen_t)(bench_coo_t *coo, size_t side, size_t blocks);
+
+static void gen_uniform(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    (void)blocks;
+    for (size_t e = 0; e < coo->nnz; e++) {
+        coo->i[e] = rng() % side;
+        coo->j[e] = rng() % side;
+    }
+}
+
+// Row and column numbers drawn from a Zipf-like law, so that a few rows and columns hold most elements
+static void gen_powerlaw(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    (void)blocks;
+    for (size_t e = 0; e < coo->nnz; e++) {
+        coo->i[e] = (size_t)((double)side * pow(uniform(), 3.0));
+        coo->j[e] = (size_t)((double)side * pow(uniform(), 3.0));
+    }
+}
+
+// Elements within 8 of the diagonal
+static void gen_banded(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    (void)blocks;
+    for (size_t e = 0; e < coo->nnz; e++) {
+        const size_t i = rng() % side;
+        const size_t lo = i < 8 ? 0 : i - 8;
+        const size_t hi = i + 8 >= side ? side - 1 : i + 8;
+        coo->i[e] = i;
+        coo->j[e] = lo + rng() % (hi - lo + 1);
+    }
+}
+
+// `blocks` independent diagonal blocks of equal size
+static void gen_blocks(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    const size_t width = side / blocks ? side / blocks : 1;
+    for (size_t e = 0; e < coo->nnz; e++) {
+        const size_t base = (rng() % blocks) * width;
+        coo->i[e] = base + rng() % width;
+        coo->j[e] = base + rng() % width;
+    }
+}
+
+static int coo_compare(const void *a, const void *b)
+{
+    const size_t *x = a;
+    const size_t *y = b;
+    if (x[0] != y[0]) {
+        return x[0] > y[0] ? 1 : -1;
+    }
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+// Uniform elements, sorted in row-major order, or its reverse
+static void gen_sorted(bench_coo_t *coo, size_t side, bool reverse)
+{
+    size_t *pairs = malloc(2 * coo->nnz * sizeof(size_t));
+    for (size_t e = 0; e < coo->nnz; e++) {
+        pairs[2 * e] = rng() % side;
+        pairs[2 * e + 1] = rng() % side;
+    }
+    qsort(pairs, coo->nnz, 2 * sizeof(size_t), coo_compare);
+    for (size_t e = 0; e < coo->nnz; e++) {
+        const size_t k = reverse ? coo->nnz - 1 - e : e;
+        coo->i[e] = pairs[2 * k];
+        coo->j[e] = pairs[2 * k + 1];
+    }
+    free(pairs);
+}
+
+static void gen_ordered(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    (void)blocks;
+    gen_sorted(coo, side, false);
+}
+
+static void gen_reverse(bench_coo_t *coo, size_t side, size_t blocks)
+{
+    (void)blocks;
+    gen_sorted(coo, side, true);
+}
+
+static const struct {
+    const char *name;
+    bench_gen_t gen;
+} generators[] = {
+    { "uniform", gen_uniform },
+    { "powerlaw", gen_powerlaw },
+    { "banded", gen_banded },
+    { "blocks", gen_blocks },
+    { "ordered", gen_ordered },
+    { "reverse", gen_reverse },
+};
+
+static const char *ops[] = { "insert", "dupl", "remove_row", "remove_col", "remove_rows", "partition", "free" };
+
+// Shuffle the row or column numbers of `matrix` into `index`, returning how many there are
+static size_t shuffled(const slm_matrix_t *matrix, bool rows, size_t **index)
+{
+    const size_t count = rows ? matrix->m : matrix->n;
+    size_t *k = malloc((count ? count : 1) * sizeof(size_t));
+    size_t c = 0;
+    for (slm_vec_t *vec = rows ? matrix->first_row : matrix->first_col; vec; vec = vec->next) {
+        k[c++] = vec->index;
+    }
+    for (size_t x = count; x > 1; x--) {
+        const size_t y = rng() % x;
+        const size_t swap = k[x - 1];
+        k[x - 1] = k[y];
+        k[y] = swap;
+    }
+    *index = k;
+    return count;
+}
+
+// Run operation `op` over the matrix generated into `coo`, printing its JSON object
+static void run_case(const char *gen, const char *op, const bench_coo_t *coo)
+{
+    slm_matrix_t *matrix = NULL;
+    if (strcmp(op, "insert")) {
+        matrix = slm_matrix_from_coo(coo->i, coo->j, coo->nnz);
+    }
+    slm_matrix_t *dupl = NULL;
+    size_t *index = NULL;
+    size_t count = 0;
+    if (!strcmp(op, "remove_row") || !strcmp(op, "remove_col") || !strcmp(op, "remove_rows")) {
+        count = shuffled(matrix, strcmp(op, "remove_col"), &index);
+    }
+
+    const size_t allocs0 = allocs;
+    const size_t frees0 = frees;
+    size_t ops_done = coo->nnz;
+    double t0 = now();
+    if (!strcmp(op, "insert")) {
+        matrix = slm_matrix_new();
+        for (size_t e = 0; e < coo->nnz; e++) {
+            slm_matrix_insert(matrix, coo->i[e], coo->j[e]);
+        }
+    }
+    else if (!strcmp(op, "dupl")) {
+        dupl = slm_matrix_dupl(matrix);
+    }
+    else if (!strcmp(op, "remove_row")) {
+        for (size_t k = 0; k < count; k++) {
+            slm_matrix_remove_row(matrix, index[k]);
+        }
+        ops_done = count;
+    }
+    else if (!strcmp(op, "remove_col")) {
+        for (size_t k = 0; k < count; k++) {
+            slm_matrix_remove_col(matrix, index[k]);
+        }
+        ops_done = count;
+    }
+    else if (!strcmp(op, "remove_rows")) {
+        slm_matrix_remove_rows(matrix, index, count);
+        ops_done = count;
+    }
+    else if (!strcmp(op, "partition")) {
+        // Peel off one block at a time, as a caller splitting a matrix fully would
+        ops_done = 0;
+        slm_matrix_t *A;
+        slm_matrix_t *B;
+        while (slm_diagonal_partition(matrix, &A, &B)) {
+            slm_matrix_free(A);
+            slm_matrix_free(matrix);
+            matrix = B;
+            ops_done++;
+        }
+        ops_done++;
+    }
+    else {
+        slm_matrix_free(matrix);
+        matrix = NULL;
+    }
+    double t1 = now();
+    const size_t op_allocs = allocs - allocs0;
+    const size_t op_frees = frees - frees0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("  {\"generator\": \"%s\", \"op\": \"%s\", \"elements\": %zu, \"ops\": %zu, \"ns_per_op\": %.1f, "
+           "\"peak_rss_kb\": %ld, \"allocs\": %zu, \"frees\": %zu}",
+           gen, op, coo->nnz, ops_done, (t1 - t0) * 1e9 / (double)(ops_done ? ops_done : 1),
+           usage.ru_maxrss, op_allocs, op_frees);
+
+    free(index);
+    if (dupl) {
+        slm_matrix_free(dupl);
+    }
+    if (matrix) {
+        slm_matrix_free(matrix);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t nnz = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+    const size_t side = argc > 2 ? strtoull(argv[2], NULL, 10) : 20000;
+    const size_t blocks = argc > 3 ? strtoull(argv[3], NULL, 10) : 16;
+    if (!nnz || !side || !blocks) {
+        fprintf(stderr, "usage: %s [elements] [side] [blocks]\n", argv[0]);
+        return 1;
+    }
+
+    printf("[\n");
+    bool first = true;
+    for (size_t g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+        for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+            printf("%s", first ? "" : ",\n");
+            first = false;
+            fflush(stdout);
+
+            // A fresh process per case keeps peak RSS and allocation counts its own
+            const pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+            if (!pid) {
+                rng_state += g;
+                bench_coo_t coo = {
+                    .i = malloc(nnz * sizeof(size_t)),
+                    .j = malloc(nnz * sizeof(size_t)),
+                    .nnz = nnz
+                };
+                generators[g].gen(&coo, side, blocks);
+                run_case(generators[g].name, ops[o], &coo);
+                free(coo.i);
+                free(coo.j);
+                fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+                fprintf(stderr, "%s/%s failed\n", generators[g].name, ops[o]);
+                return 1;
+            }
+        }
+    }
+    printf("\n]\n");
+    return 0;
+}
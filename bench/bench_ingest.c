@@ -0,0 +1,111 @@
+// Concurrent insertion, through `slm_ingest_t` against one mutex around `slm_matrix_insert`, from one thread up to N
+//
+//   cc -O2 -pthread -I. bench/bench_ingest.c slm.c -o bench_ingest
+//
+// Usage: bench_ingest [side] [elements] [max threads]
+
+#include "slm.h"
+#include <time.h>
+#include <unistd.h>
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct bench_task_t {
+    slm_matrix_t *matrix;
+    slm_ingest_t *ingest;
+    pthread_mutex_t *lock;
+    size_t side;
+    size_t count;
+    uint64_t seed;
+} bench_task_t;
+
+static uint64_t rng(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void *producer(void *arg)
+{
+    bench_task_t *task = arg;
+    uint64_t state = task->seed;
+    for (size_t e = 0; e < task->count; e++) {
+        const size_t m = rng(&state) % task->side;
+        const size_t n = rng(&state) % task->side;
+        if (task->ingest) {
+            slm_ingest_insert(task->ingest, m, n);
+        }
+        else {
+            pthread_mutex_lock(task->lock);
+            slm_matrix_insert(task->matrix, m, n);
+            pthread_mutex_unlock(task->lock);
+        }
+    }
+    return NULL;
+}
+
+// Insert `nnz` random elements split over `threads` producers, returning the seconds taken
+static double run(size_t side, size_t nnz, size_t threads, bool ingest, size_t *total)
+{
+    slm_matrix_t *matrix = slm_matrix_new();
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    bench_task_t *tasks = malloc(threads * sizeof(bench_task_t));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+
+    double t0 = now();
+    slm_ingest_t *ing = ingest ? slm_ingest_new(matrix, threads) : NULL;
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t] = (bench_task_t) {
+            .matrix = matrix,
+            .ingest = ing,
+            .lock = &lock,
+            .side = side,
+            .count = nnz / threads + (t < nnz % threads),
+            .seed = 0x9e3779b97f4a7c15 + t
+        };
+        pthread_create(&ids[t], NULL, producer, &tasks[t]);
+    }
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    if (ing) {
+        slm_ingest_free(ing);
+    }
+    double t1 = now();
+
+    *total = slm_total_elements(matrix);
+    slm_matrix_free(matrix);
+    free(ids);
+    free(tasks);
+    return t1 - t0;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t side = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+    const size_t nnz = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000000;
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t max_threads = argc > 3 ? strtoull(argv[3], NULL, 10) : (cpus > 0 ? (size_t)cpus : 1);
+    if (!side || !nnz || !max_threads) {
+        fprintf(stderr, "usage: %s [side] [elements] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    printf("threads\tmutex (s)\tingest (s)\telements\n");
+    // Powers of two, then `max_threads` itself if it is not one
+    for (size_t t = 1; t <= max_threads; t = (t == max_threads) ? t + 1 : (2 * t > max_threads ? max_threads : 2 * t)) {
+        size_t locked = 0;
+        size_t sharded = 0;
+        const double a = run(side, nnz, t, false, &locked);
+        const double b = run(side, nnz, t, true, &sharded);
+        printf("%zu\t%.4f\t\t%.4f\t\t%zu%s\n", t, a, b, sharded, locked == sharded ? "" : " (mismatch)");
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Boolean product against a dense bitset baseline, from one thread up to N
+//
+//   cc -O2 -pthread -I. bench/bench_mul.c slm.c -o bench_mul
+//
+// Usage: bench_mul [side] [elements per row] [max threads]
+
+#include "slm.h"
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Dense baseline: every row of the product is the OR of whole bitset rows of `B`
+static size_t dense_mul(const size_t *i, const size_t *j, size_t nnz, size_t side)
+{
+    const size_t words = (side + 63) / 64;
+    uint64_t *a = calloc(side * words, sizeof(uint64_t));
+    uint64_t *b = calloc(side * words, sizeof(uint64_t));
+    uint64_t *acc = malloc(words * sizeof(uint64_t));
+    for (size_t e = 0; e < nnz; e++) {
+        a[i[e] * words + j[e] / 64] |= (uint64_t)1 << (j[e] % 64);
+        b[i[e] * words + j[e] / 64] |= (uint64_t)1 << (j[e] % 64);
+    }
+
+    size_t count = 0;
+    for (size_t r = 0; r < side; r++) {
+        memset(acc, 0, words * sizeof(uint64_t));
+        for (size_t w = 0; w < words; w++) {
+            for (uint64_t bits = a[r * words + w]; bits; bits &= bits - 1) {
+                const uint64_t *row = b + (w * 64 + (size_t)__builtin_ctzll(bits)) * words;
+                for (size_t x = 0; x < words; x++) {
+                    acc[x] |= row[x];
+                }
+            }
+        }
+        for (size_t x = 0; x < words; x++) {
+            count += (size_t)__builtin_popcountll(acc[x]);
+        }
+    }
+
+    free(acc);
+    free(b);
+    free(a);
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t side = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+    const size_t degree = argc > 2 ? strtoull(argv[2], NULL, 10) : 8;
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t max_threads = argc > 3 ? strtoull(argv[3], NULL, 10) : (cpus > 0 ? (size_t)cpus : 1);
+
+    // A random square with `degree` elements per row on average, multiplied by itself
+    const size_t nnz = side * degree;
+    size_t *i = malloc(nnz * sizeof(size_t));
+    size_t *j = malloc(nnz * sizeof(size_t));
+    for (size_t e = 0; e < nnz; e++) {
+        i[e] = rng() % side;
+        j[e] = rng() % side;
+    }
+    slm_matrix_t *matrix = slm_matrix_from_coo(i, j, nnz);
+
+    double t0 = now();
+    const size_t dense = dense_mul(i, j, nnz, side);
+    double t1 = now();
+    free(i);
+    free(j);
+
+    printf("%zu rows, %zu cols, %zu elements\n", matrix->m, matrix->n, slm_total_elements(matrix));
+    printf("dense bitset: %.4f s, %zu elements\n", t1 - t0, dense);
+    printf("threads\tsparse (s)\telements\n");
+    for (size_t t = 1; t <= max_threads; t *= 2) {
+        t0 = now();
+        slm_matrix_t *product = slm_matrix_mul_parallel(matrix, matrix, t);
+        t1 = now();
+        printf("%zu\t%.4f\t\t%zu\n", t, t1 - t0, slm_total_elements(product));
+        slm_matrix_free(product);
+        if ((t < max_threads) && (2 * t > max_threads)) {
+            t = max_threads / 2;
+        }
+    }
+
+    slm_matrix_free(matrix);
+    return 0;
+}
@@ -1,5 +1,12 @@
 #include "slm.h"
 
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
 static void *xmalloc(size_t size)
 {
     void *ptr = malloc(size);
@@ -20,11 +27,11 @@ static void *xcalloc(size_t count, size_t size)
 
 static void *xrealloc(void *ptr, size_t size)
 {
-    void *ptr = realloc(ptr, size);
-    if (unlikely(!ptr)) {
+    void *new_ptr = realloc(ptr, size);
+    if (unlikely(!new_ptr)) {
         abort();
     }
-    return ptr;
+    return new_ptr;
 }
 
 static void xfree(void *ptr)
@@ -32,657 +39,5162 @@ static void xfree(void *ptr)
     free(ptr);
 }
 
-slm_vec_t *slm_vec_new(void)
+#if SLM_STATS
+static slm_stats_t slm_stats;
+
+#define slm_stat_add(field, k) __atomic_fetch_add(&slm_stats.field, (uint64_t)(k), __ATOMIC_RELAXED)
+#define slm_stat_max(field, k) slm_stat_raise(&slm_stats.field, (uint64_t)(k))
+
+static void slm_stat_raise(uint64_t *field, uint64_t value)
 {
-    return xcalloc(1, sizeof(slm_vec_t));
+    uint64_t cur = __atomic_load_n(field, __ATOMIC_RELAXED);
+    while ((cur < value) && !__atomic_compare_exchange_n(field, &cur, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 }
 
-slm_elem_t *slm_elem_new(void)
+static uint64_t slm_stat_clock(void)
 {
-    return xcalloc(1, sizeof(slm_elem_t));
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
 }
 
-slm_matrix_t *slm_matrix_new(void)
+// Account for a partition call begun at `start`
+static void slm_stat_partition(uint64_t start)
 {
-    return xcalloc(1, sizeof(slm_matrix_t));
+    const uint64_t ns = slm_stat_clock() - start;
+    slm_stat_add(partitions, 1);
+    slm_stat_add(partition_ns, ns);
+    slm_stat_max(partition_ns_max, ns);
 }
+#else
+#define slm_stat_add(field, k) ((void)(k))
+#define slm_stat_max(field, k) ((void)(k))
+#define slm_stat_clock() ((uint64_t)0)
+#define slm_stat_partition(start) ((void)(start))
+#endif
 
-void slm_row_free(slm_vec_t *row)
+void slm_stats_get(slm_stats_t *stats)
 {
-    for_each_element_in_row_safe(elem, row) {
-        xfree(elem);
+#if SLM_STATS
+    const uint64_t *src = (const uint64_t *)&slm_stats;
+    uint64_t *dst = (uint64_t *)stats;
+    for (size_t k = 0; k < sizeof(slm_stats_t) / sizeof(uint64_t); k++) {
+        dst[k] = __atomic_load_n(&src[k], __ATOMIC_RELAXED);
     }
-    xfree(row);
+#else
+    memset(stats, 0, sizeof(slm_stats_t));
+#endif
 }
 
-void slm_col_free(slm_vec_t *col)
+void slm_stats_reset(void)
 {
-    for_each_element_in_col_safe(elem, col) {
-        xfree(elem);
+#if SLM_STATS
+    uint64_t *dst = (uint64_t *)&slm_stats;
+    for (size_t k = 0; k < sizeof(slm_stats_t) / sizeof(uint64_t); k++) {
+        __atomic_store_n(&dst[k], 0, __ATOMIC_RELAXED);
     }
-    xfree(col);
+#endif
 }
 
-void slm_matrix_free(slm_matrix_t *matrix)
+// Slabs start small so that tiny matrices stay tiny, doubling up to `SLM_SLAB_MAX` objects
+#define SLM_SLAB_MIN ((size_t)64)
+#define SLM_SLAB_MAX ((size_t)1 << SLM_SLAB_SHIFT)
+
+#if SLM_COMPACT && !SLM_POOL
+    #error "SLM_COMPACT requires SLM_POOL"
+#endif
+
+static void slm_pool_init(slm_pool_t *pool, size_t size)
 {
-    for_each_row_in_matrix_safe(row, matrix) {
-        slm_row_free(row);
+    *pool = (slm_pool_t) {
+        .size = size
+    };
+}
+
+#if SLM_POOL
+static void slm_pool_grow(slm_pool_t *pool)
+{
+#if SLM_COMPACT
+    // Slot numbers carry the slab number in their upper bits
+    if (unlikely(pool->count == ((size_t)1 << (32 - SLM_SLAB_SHIFT)))) {
+        abort();
     }
-    for_each_col_in_matrix_safe(col, matrix) {
-        col->last = NULL;
-        col->first = NULL;
-        slm_col_free(col);
+#endif
+    if (pool->count == pool->slabs_size) {
+        pool->slabs_size = pool->slabs_size ? 2 * pool->slabs_size : 16;
+        pool->slabs = xrealloc(pool->slabs, sizeof(void *) * pool->slabs_size);
     }
-
-    xfree(matrix->rows);
-    xfree(matrix->cols);
-    xfree(matrix);
+    const size_t shift = pool->count < 10 ? pool->count : 10;
+    const size_t objects = (SLM_SLAB_MIN << shift) < SLM_SLAB_MAX ? (SLM_SLAB_MIN << shift) : SLM_SLAB_MAX;
+    pool->slabs[pool->count++] = xcalloc(objects, pool->size);
+    pool->capacity = objects;
+    // Slot 0 stands for "no element", so the first object is never handed out
+    pool->used = (SLM_COMPACT && (pool->count == 1)) ? 1 : 0;
 }
+#endif
 
-slm_vec_t *slm_get_row(slm_matrix_t *matrix, size_t m)
+// Return a zeroed object from `pool`, preferring recycled objects over fresh slab space
+// With `SLM_COMPACT`, the slot number of the object is stored to `slot` if non-NULL
+static void *slm_pool_alloc(slm_pool_t *pool, uint32_t *slot)
 {
-    return unlikely(m >= matrix->rows_size) ? NULL : matrix->rows[m];
+#if SLM_POOL
+    char *obj = pool->free_list;
+    if (obj) {
+        pool->free_list = *(void **)obj;
+        if (SLM_COMPACT && slot) {
+            memcpy(slot, obj + sizeof(void *), sizeof(uint32_t));
+        }
+        memset(obj, 0, pool->size);
+        return obj;
+    }
+    if (unlikely(pool->used == pool->capacity)) {
+        slm_pool_grow(pool);
+    }
+    if (SLM_COMPACT && slot) {
+        *slot = (uint32_t)(((pool->count - 1) << SLM_SLAB_SHIFT) | pool->used);
+    }
+    obj = (char *)pool->slabs[pool->count - 1] + pool->used * pool->size;
+    pool->used++;
+    return obj;
+#else
+    (void)slot;
+    return xcalloc(1, pool->size);
+#endif
 }
 
-slm_vec_t *slm_get_col(slm_matrix_t *matrix, size_t n)
+// Return `obj`, with slot number `slot` if `SLM_COMPACT`, to `pool`
+static void slm_pool_free(slm_pool_t *pool, void *obj, uint32_t slot)
 {
-    return unlikely(n >= matrix->cols_size) ? NULL : matrix->cols[n];
+#if SLM_POOL
+    *(void **)obj = pool->free_list;
+    if (SLM_COMPACT) {
+        memcpy((char *)obj + sizeof(void *), &slot, sizeof(uint32_t));
+    }
+    pool->free_list = obj;
+#else
+    (void)pool;
+    (void)slot;
+    xfree(obj);
+#endif
 }
 
-slm_vec_t *slm_row_dupl(slm_vec_t *row)
+// Release every slab owned by `pool` at once
+static void slm_pool_release(slm_pool_t *pool)
 {
-    slm_vec_t *new_row = slm_vec_new();
-    for_each_element_in_row(cell, row) {
-        slm_row_insert(new_row, cell->j);
+    for (size_t i = 0; i < pool->count; i++) {
+        xfree(pool->slabs[i]);
     }
-    return new_row;
+    xfree(pool->slabs);
 }
 
-// Insert `element` into the row `row` at index (column) `n`
-static inline slm_elem_t *slm_insert_into_row(slm_vec_t *row, size_t n, slm_elem_t *element)
-{
-    slm_elem_t *elem = element;
-    if (!row->last) {
-        element->j = n;
-        row->first = element;
-        row->last = element;
-        element->next_col = NULL;
-        element->prev_col = NULL;
-        row->length++;
-    }
-    else if (row->last->j < n) {
-        element->j = n;
-        row->last->next_col = element;
-        element->prev_col = row->last;
-        row->last = element;
-        element->next_col = NULL;
-        row->length++;
-    }
-    else if (row->first->j > n) {
-        element->j = n;
-        row->first->prev_col = element;
-        element->next_col = row->first;
-        row->first = element;
-        element->prev_col = NULL;
-        row->length++;
-    }
-    else {
-        slm_elem_t *itr = row->first;
-        for (; itr->j < n; itr = itr->next_col);
-        if (itr->j > n) {
-            element->j = n;
-            itr = itr->prev_col;
-            itr->next_col->prev_col = element;
-            element->next_col = itr->next_col;
-            itr->next_col = element;
-            element->prev_col = itr;
-            row->length++;
-        }
-        else {
-            element = itr;
-        }
-    }
-    if (unlikely(elem != element)) {
-        xfree(elem);
-        elem = NULL;
-    }
-    return elem;
+static slm_arena_t *slm_arena_new(void)
+{
+    slm_arena_t *arena = xmalloc(sizeof(slm_arena_t));
+    slm_pool_init(&arena->elems, sizeof(slm_elem_t));
+    slm_pool_init(&arena->vecs, sizeof(slm_vec_t));
+    arena->refs = 1;
+    return arena;
 }
 
-// Insert `element` into the column `col` at index (row) `m`
-static inline slm_elem_t *slm_insert_into_col(slm_vec_t *col, size_t m, slm_elem_t *element)
+static void slm_arena_free(slm_arena_t *arena)
 {
-    slm_elem_t *elem = element;
-    if (!col->last) {
-        element->i = m;
-        col->first = element;
-        col->last = element;
-        element->next_row = NULL;
-        element->prev_row = NULL;
-        col->length++;
-    }
-    else if (col->last->i < m) {
-        element->i = m;
-        col->last->next_row = element;
-        element->prev_row = col->last;
-        col->last = element;
-        element->next_row = NULL;
-        col->length++;
+    slm_pool_release(&arena->elems);
+    slm_pool_release(&arena->vecs);
+    xfree(arena);
+}
+
+// Drop a reference to `arena`, freeing it along with the last one
+static void slm_arena_release(slm_arena_t *arena)
+{
+    if (!__atomic_sub_fetch(&arena->refs, 1, __ATOMIC_ACQ_REL)) {
+        slm_arena_free(arena);
     }
-    else if (col->first->i > m) {
-        element->i = m;
-        col->first->prev_row = element;
-        element->next_row = col->first;
-        col->first = element;
-        element->prev_row = NULL;
-        col->length++;
+}
+
+// Allocate an element from `arena`, storing the link through which it is reachable to `link`
+static slm_elem_t *slm_elem_alloc(slm_arena_t *arena, slm_link_t *link)
+{
+    slm_stat_add(elem_allocs, 1);
+#if SLM_COMPACT
+    return slm_pool_alloc(&arena->elems, link);
+#else
+    *link = slm_pool_alloc(&arena->elems, NULL);
+    return *link;
+#endif
+}
+
+static void slm_elem_release(slm_arena_t *arena, slm_elem_t *elem, slm_link_t link)
+{
+    slm_stat_add(elem_frees, 1);
+#if SLM_COMPACT
+    slm_pool_free(&arena->elems, elem, link);
+#else
+    (void)link;
+    slm_pool_free(&arena->elems, elem, 0);
+#endif
+}
+
+static slm_vec_t *slm_vec_alloc(slm_arena_t *arena)
+{
+    slm_stat_add(vec_allocs, 1);
+    slm_vec_t *vec = slm_pool_alloc(&arena->vecs, NULL);
+    vec->arena = arena;
+    return vec;
+}
+
+static void slm_vec_release(slm_vec_t *vec)
+{
+    slm_stat_add(vec_frees, 1);
+    xfree(vec->dense);
+    if (vec->owns_arena) {
+        slm_arena_free(vec->arena);
+        xfree(vec);
     }
     else {
-        slm_elem_t *itr = col->first;
-        for (; itr->i < m; itr = itr->next_row);
-        if (itr->i > m) {
-            element->i = m;
-            itr = itr->prev_row;
-            itr->next_row->prev_row = element;
-            element->next_row = itr->next_row;
-            itr->next_row = element;
-            element->prev_row = itr;
-            col->length++;
-        }
-        else {
-            element = itr;
-        }
+        slm_pool_free(&vec->arena->vecs, vec, 0);
     }
-    if (unlikely(elem != element)) {
-        xfree(elem);
-        elem = NULL;
-    }
-    return elem;
 }
 
-slm_elem_t *slm_row_insert(slm_vec_t *row, size_t n)
+slm_vec_t *slm_vec_new(void)
 {
-    slm_elem_t *element = slm_elem_new();
-    return slm_insert_into_row(row, n, element);
+    slm_stat_add(vec_allocs, 1);
+    slm_vec_t *vec = xcalloc(1, sizeof(slm_vec_t));
+    vec->arena = slm_arena_new();
+    vec->owns_arena = true;
+    return vec;
 }
 
-void slm_row_remove(slm_vec_t *row, size_t index)
+slm_elem_t *slm_elem_new(void)
 {
-    slm_elem_t *cell = row->first;
-    for (; cell && cell->j < index; cell = cell->next_col);
-    if (cell && (cell->j == index)) {
-        if (!cell->prev_col) {
-            row->first = cell->next_col;
-        }
-        else {
-            cell->prev_col->next_col = cell->next_col;
-        }
-        if (!cell->next_col) {
-            row->last = cell->prev_col;
-        }
-        else {
-            cell->next_col->prev_col = cell->prev_col;
-        }
-        row->length--;
-        xfree(cell);
-    }
+    slm_stat_add(elem_allocs, 1);
+    return xcalloc(1, sizeof(slm_elem_t));
 }
 
-void slm_matrix_resize_row(slm_matrix_t *matrix, size_t m)
+// Hash of the point (`m`, `n`), with every bit of either index reaching the low bits
+static inline size_t slm_hash_point(size_t m, size_t n)
 {
-    const size_t size = (2 * matrix->rows_size) > (m + 1) ? (2 * matrix->rows_size) : (m + 1);
-    matrix->rows = xrealloc(matrix->rows, sizeof(slm_vec_t *) * size);
-    for (size_t i = matrix->rows_size; i < size; i++) {
-        matrix->rows[i] = NULL;
-    }
-    matrix->rows_size = size;
+    uint64_t h = (uint64_t)m * 0x9e3779b97f4a7c15u ^ (uint64_t)n;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93u;
+    h ^= h >> 32;
+    return (size_t)h;
 }
 
-void slm_matrix_resize_col(slm_matrix_t *matrix, size_t n)
+static slm_hash_t *slm_hash_new(size_t size)
 {
-    const size_t size = (2 * matrix->cols_size) > (n + 1) ? (2 * matrix->cols_size) : (n + 1);
-    matrix->cols = xrealloc(matrix->cols, sizeof(slm_vec_t *) * size);
-    for (size_t i = matrix->cols_size; i < size; i++) {
-        matrix->cols[i] = NULL;
-    }
-    matrix->cols_size = size;
+    slm_hash_t *hash = xmalloc(sizeof(slm_hash_t));
+    *hash = (slm_hash_t) {
+        .slots = xcalloc(size, sizeof(slm_hash_slot_t)),
+        .size = size
+    };
+    return hash;
 }
 
-void slm_matrix_resize(slm_matrix_t *matrix, size_t m, size_t n)
+static void slm_hash_free(slm_hash_t *hash)
 {
-    if (m >= matrix->rows_size) {
-        slm_matrix_resize_row(matrix, m);
+    if (hash) {
+        xfree(hash->slots);
+        xfree(hash);
     }
-    if (n >= matrix->cols_size) {
-        slm_matrix_resize_col(matrix, n);
+}
+
+// Return the slot holding the point (`m`, `n`), or the empty slot ending its probe sequence
+static inline slm_hash_slot_t *slm_hash_slot(const slm_hash_t *hash, size_t m, size_t n)
+{
+    const size_t mask = hash->size - 1;
+    size_t k = slm_hash_point(m, n) & mask;
+    while (hash->slots[k].link && ((hash->slots[k].i != m) || (hash->slots[k].j != n))) {
+        k = (k + 1) & mask;
     }
+    return &hash->slots[k];
 }
 
-slm_matrix_t *slm_matrix_dupl(slm_matrix_t *matrix)
+static void slm_hash_put(slm_hash_t *hash, size_t m, size_t n, slm_link_t link);
+
+// Double the number of slots of `hash`, keeping the load factor below 3/4
+static void slm_hash_grow(slm_hash_t *hash)
 {
-    slm_matrix_t *dupl = slm_matrix_new();
-    if (matrix->last_row) {
-        slm_matrix_resize(dupl, matrix->last_row->index, matrix->last_col->index);
-        for_each_row_in_matrix(row, matrix) {
-            for_each_element_in_row(cell, row) {
-                slm_matrix_insert(dupl, cell->i, cell->j);
-            }
+    slm_hash_slot_t *slots = hash->slots;
+    const size_t size = hash->size;
+    hash->size *= 2;
+    hash->slots = xcalloc(hash->size, sizeof(slm_hash_slot_t));
+    hash->count = 0;
+    for (size_t k = 0; k < size; k++) {
+        if (slots[k].link) {
+            slm_hash_put(hash, slots[k].i, slots[k].j, slots[k].link);
         }
     }
-    return dupl;
+    xfree(slots);
 }
 
-// Add a new row, `row` to `matrix` at index `m`
-static inline void slm_add_row(slm_matrix_t *matrix, slm_vec_t *row, size_t m)
+static void slm_hash_put(slm_hash_t *hash, size_t m, size_t n, slm_link_t link)
 {
-    if (!matrix->last_row) {
-        row->index = m;
-        matrix->first_row = row;
-        matrix->last_row = row;
-        row->next = NULL;
-        row->prev = NULL;
-        matrix->m++;
+    if (unlikely(4 * (hash->count + 1) > 3 * hash->size)) {
+        slm_hash_grow(hash);
     }
-    else if (matrix->last_row->index < m) {
-        row->index = m;
-        matrix->last_row->next = row;
-        row->prev = matrix->last_row;
-        matrix->last_row = row;
-        row->next = NULL;
-        matrix->m++;
+    slm_hash_slot_t *slot = slm_hash_slot(hash, m, n);
+    if (!slot->link) {
+        hash->count++;
     }
-    else if (matrix->first_row->index > m) {
-        row->index = m;
-        matrix->first_row->prev = row;
-        row->next = matrix->first_row;
-        matrix->first_row = row;
-        row->prev = NULL;
-        matrix->m++;
+    *slot = (slm_hash_slot_t) {
+        .i = m,
+        .j = n,
+        .link = link
+    };
+}
+
+// Remove the point (`m`, `n`), shifting later members of its probe sequence back rather than leaving a tombstone
+static void slm_hash_remove(slm_hash_t *hash, size_t m, size_t n)
+{
+    const size_t mask = hash->size - 1;
+    slm_hash_slot_t *slot = slm_hash_slot(hash, m, n);
+    if (!slot->link) {
+        return;
     }
-    else {
-        slm_vec_t *itr = matrix->first_row;
-        for (; itr->index < m; itr = itr->next);
-        if (itr->index > m) {
-            row->index = m;
-            itr = itr->prev;
-            itr->next->prev = row;
-            row->next = itr->next;
-            itr->next = row;
-            row->prev = itr;
-            matrix->m++;
+    size_t hole = (size_t)(slot - hash->slots);
+    for (size_t k = (hole + 1) & mask; hash->slots[k].link; k = (k + 1) & mask) {
+        const size_t home = slm_hash_point(hash->slots[k].i, hash->slots[k].j) & mask;
+        // Move the entry into the hole unless its home lies cyclically within (hole, k]
+        if (((k - home) & mask) >= ((k - hole) & mask)) {
+            hash->slots[hole] = hash->slots[k];
+            hole = k;
         }
     }
+    hash->slots[hole].link = SLM_NIL;
+    hash->count--;
 }
 
-// Add a new column, `col` to `matrix` at index `n`
-static inline void slm_add_col(slm_matrix_t *matrix, slm_vec_t *col, size_t n)
+static int slm_index_compare(const void *a, const void *b)
 {
-    if (!matrix->last_col) {
-        col->index = n;
-        matrix->first_col = col;
-        matrix->last_col = col;
-        col->next = NULL;
-        col->prev = NULL;
-        matrix->n++;
+    const size_t x = *(const size_t *)a;
+    const size_t y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+static slm_components_t *slm_components_new(void)
+{
+    return xcalloc(1, sizeof(slm_components_t));
+}
+
+static void slm_components_free(slm_components_t *components)
+{
+    if (components) {
+        xfree(components->parent);
+        xfree(components->next);
+        xfree(components->stale);
+        xfree(components);
     }
-    else if (matrix->last_col->index < n) {
-        col->index = n;
-        matrix->last_col->next = col;
-        col->prev = matrix->last_col;
-        matrix->last_col = col;
-        col->next = NULL;
-        matrix->n++;
+}
+
+// Cover every node up to and including `node`
+static void slm_components_reserve(slm_components_t *components, size_t node)
+{
+    if (node < components->size) {
+        return;
     }
-    else if (matrix->first_col->index > n) {
-        col->index = n;
-        matrix->first_col->prev = col;
-        col->next = matrix->first_col;
-        matrix->first_col = col;
-        col->prev = NULL;
-        matrix->n++;
+    size_t size = components->size ? components->size : 64;
+    while (size <= node) {
+        size *= 2;
     }
-    else {
-        slm_vec_t *itr = matrix->first_col;
-        for (; itr->index < n; itr = itr->next);
-        if (itr->index > n) {
-            col->index = n;
-            itr = itr->prev;
-            itr->next->prev = col;
-            col->next = itr->next;
-            itr->next = col;
-            col->prev = itr;
-            matrix->n++;
-        }
+    components->parent = xrealloc(components->parent, size * sizeof(size_t));
+    components->next = xrealloc(components->next, size * sizeof(size_t));
+    for (size_t k = components->size; k < size; k++) {
+        components->parent[k] = k;
+        components->next[k] = SIZE_MAX;
     }
+    components->size = size;
 }
 
-void slm_matrix_insert(slm_matrix_t *matrix, size_t m, size_t n)
+static size_t slm_components_find(slm_components_t *components, size_t x)
 {
-    if ((m >= matrix->rows_size) || (n >= matrix->cols_size)) {
-        slm_matrix_resize(matrix, m, n);
+    size_t *parent = components->parent;
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
     }
+    return x;
+}
 
-    slm_vec_t *row = matrix->rows[m];
-    if (!row) {
-        matrix->rows[m] = slm_vec_new();
-        row = matrix->rows[m];
-        row->index = m;
-        slm_add_row(matrix, row, m);
+// Counterpart of `slm_components_find` that leaves the forest untouched, for queries on a shared matrix
+static size_t slm_components_root(const slm_components_t *components, size_t x)
+{
+    while (components->parent[x] != x) {
+        x = components->parent[x];
     }
+    return x;
+}
 
-    slm_vec_t *col = matrix->cols[n];
-    if (!col) {
-        matrix->cols[n] = slm_vec_new();
-        col = matrix->cols[n];
-        col->index = n;
-        slm_add_col(matrix, col, n);
+// Merge the sets of nodes `a` and `b`, keeping the smaller root
+static void slm_components_union(slm_components_t *components, size_t a, size_t b)
+{
+    a = slm_components_find(components, a);
+    b = slm_components_find(components, b);
+    if (a == b) {
+        return;
     }
-
-    slm_elem_t *element = slm_elem_new();
-    if (slm_insert_into_row(row, n, element)) {
-        slm_insert_into_col(col, m, element);
+    if (a < b) {
+        const size_t swap = a;
+        a = b;
+        b = swap;
     }
+    components->parent[a] = b;
+
+    // Exchanging successors splices the two circular member lists into one
+    const size_t next = components->next[a];
+    components->next[a] = components->next[b];
+    components->next[b] = next;
+    components->count--;
 }
 
-void slm_matrix_remove_row(slm_matrix_t *matrix, size_t m)
+// Bring node `x` into the matrix as a set of its own, unless it already is
+static inline void slm_components_add(slm_components_t *components, size_t x)
 {
-    slm_vec_t *row = slm_get_row(matrix, m);
-    if (row) {
-        for_each_element_in_row_safe(elem, row) {
-            slm_vec_t *col = slm_get_col(matrix, elem->j);
-            if (!elem->prev_row) {
-                col->first = elem->next_row;
-            }
-            else {
-                elem->prev_row->next_row = elem->next_row;
-            }
-            if (!elem->next_row) {
-                col->last = elem->prev_row;
-            }
-            else {
-                elem->next_row->prev_row = elem->prev_row;
-            }
-            col->length--;
-
-            xfree(elem);
-            if (!col->first) {
-                matrix->cols[col->index] = NULL;
-                if (!col->prev) {
-                    matrix->first_col = col->next;
-                }
-                else {
-                    col->prev->next = col->next;
-                }
-                if (!col->next) {
-                    matrix->last_col = col->prev;
-                }
-                else {
-                    col->next->prev = col->prev;
-                }
-                matrix->n--;
-                col->last = NULL;
-                col->first = NULL;
-                slm_col_free(col);
-            }
-        }
-        matrix->rows[m] = NULL;
-
-        if (!row->prev) {
-            matrix->first_row = row->next;
-        }
-        else {
-            row->prev->next = row->next;
-        }
-        if (!row->next) {
-            matrix->last_row = row->prev;
-        }
-        else {
-            row->next->prev = row->prev;
-        }
-        matrix->m--;
-
-        row->last = NULL;
-        row->first = NULL;
-        slm_row_free(row);
+    if (components->next[x] == SIZE_MAX) {
+        components->next[x] = x;
+        components->count++;
     }
 }
 
-void slm_matrix_remove_col(slm_matrix_t *matrix, size_t n)
+static inline bool slm_components_live(const slm_matrix_t *matrix, size_t x)
 {
-    slm_vec_t *col = slm_get_col(matrix, n);
-    if (col) {
-        for_each_element_in_col_safe(elem, col) {
-            slm_vec_t *row = slm_get_row(matrix, elem->i);
-            if (!elem->prev_col) {
-                row->first = elem->next_col;
-            }
-            else {
-                elem->prev_col->next_col = elem->next_col;
-            }
-            if (!elem->next_col) {
-                row->last = elem->prev_col;
-            }
-            else {
-                elem->next_col->prev_col = elem->prev_col;
-            }
-            row->length--;
-
-            xfree(elem);
-            if (!row->first) {
-                matrix->rows[row->index] = NULL;
+    const size_t k = x / 2;
+    return (x & 1) ? slm_get_col(matrix, k) : slm_get_row(matrix, k);
+}
 
-                if (!row->prev) {
-                    matrix->first_row = row->next;
-                }
-                else {
-                    row->prev->next = row->next;
-                }
-                if (!row->next) {
-                    matrix->last_row = row->prev;
-                }
-                else {
-                    row->next->prev = row->prev;
-                }
-                matrix->m--;
+// Relabel every stale component from scratch, visiting only its own members
+static void slm_components_settle(slm_components_t *components, const slm_matrix_t *matrix)
+{
+    size_t *members = NULL;
+    size_t members_size = 0;
+    qsort(components->stale, components->stale_count, sizeof(size_t), slm_index_compare);
+    for (size_t s = 0; s < components->stale_count; s++) {
+        const size_t root = components->stale[s];
+        if (s && (root == components->stale[s - 1])) {
+            continue;
+        }
 
-                row->last = NULL;
-                row->first = NULL;
-                slm_row_free(row);
+        // Gather the members first, as the walk relies on the lists about to be rebuilt
+        size_t count = 0;
+        size_t x = root;
+        do {
+            if (count == members_size) {
+                members_size = members_size ? 2 * members_size : 64;
+                members = xrealloc(members, members_size * sizeof(size_t));
             }
-        }
-        matrix->cols[n] = NULL;
+            members[count++] = x;
+            x = components->next[x];
+        } while (x != root);
 
-        if (!col->prev) {
-            matrix->first_col = col->next;
-        }
-        else {
-            col->prev->next = col->next;
+        components->count--;
+        for (size_t k = 0; k < count; k++) {
+            components->parent[members[k]] = members[k];
+            components->next[members[k]] = SIZE_MAX;
         }
-        if (!col->next) {
-            matrix->last_col = col->prev;
+        for (size_t k = 0; k < count; k++) {
+            if (slm_components_live(matrix, members[k])) {
+                slm_components_add(components, members[k]);
+            }
         }
-        else {
-            col->next->prev = col->prev;
+        for (size_t k = 0; k < count; k++) {
+            if (!(members[k] & 1) && slm_components_live(matrix, members[k])) {
+                for_each_element_in_row(elem, slm_get_row(matrix, members[k] / 2)) {
+                    slm_components_union(components, members[k], 2 * elem->j + 1);
+                }
+            }
         }
-        matrix->n--;
-
-        col->last = NULL;
-        col->first = NULL;
-        slm_col_free(col);
     }
+    components->stale_count = 0;
+    xfree(members);
 }
 
-static slm_elem_t *slm_row_find(slm_vec_t *row, size_t n)
+// Settle the tracked components of `matrix`, if any, ahead of an insertion
+// Relabeling relies on every element of a stale component having been there when it was marked
+static inline void slm_components_prepare(const slm_matrix_t *matrix)
 {
-    slm_elem_t *cell = row->first;
-    for (; cell && cell->j < n; cell = cell->next_col);
-    return (cell && cell->j == n) ? cell : NULL;
+    if (matrix->components && matrix->components->stale_count) {
+        slm_components_settle(matrix->components, matrix);
+    }
 }
 
-static void slm_print(FILE *fp, slm_matrix_t *matrix)
+// Record the element (`m`, `n`), once its component is settled
+static void slm_components_link(slm_components_t *components, size_t m, size_t n)
 {
-    for_each_row_in_matrix(row, matrix) {
-        fprintf(fp, "%-7zu\t", row->index);
-        for_each_col_in_matrix(col, matrix) {
-            char c = slm_row_find(row, col->index) ? '1' : '-';
-            putc(c, fp);
-        }
-        putc('\n', fp);
-    }
+    slm_components_reserve(components, 2 * (m > n ? m : n) + 1);
+    slm_components_add(components, 2 * m);
+    slm_components_add(components, 2 * n + 1);
+    slm_components_union(components, 2 * m, 2 * n + 1);
 }
 
-void slm_matrix_print(FILE *f, slm_matrix_t *matrix)
+// Mark the component of node `x` stale, ahead of the removal of its row / column
+// Removals leave the forest as it is, so repeat marks of one component share a root
+static void slm_components_invalidate(slm_components_t *components, size_t x)
 {
-    if (!matrix->m || !matrix->n) {
+    const size_t root = slm_components_find(components, x);
+    if (components->stale_count && (components->stale[components->stale_count - 1] == root)) {
         return;
     }
+    if (components->stale_count == components->stale_size) {
+        components->stale_size = components->stale_size ? 2 * components->stale_size : 16;
+        components->stale = xrealloc(components->stale, components->stale_size * sizeof(size_t));
+    }
+    components->stale[components->stale_count++] = root;
+}
+
+// Note that any row of `matrix` may have changed
+static inline void slm_versions_invalidate(slm_matrix_t *matrix)
+{
+    if (matrix->versions) {
+        matrix->versions->stale = true;
+        matrix->versions->dirty_count = 0;
+    }
+}
+
+// Note that row `m` of `matrix` changed, for the next snapshot to copy
+// Once more rows are noted than the matrix holds, every row is taken to have changed instead,
+// which bounds the log however often the same rows change between snapshots
+static inline void slm_versions_touch(slm_matrix_t *matrix, size_t m)
+{
+    slm_versions_t *versions = matrix->versions;
+    if (!versions || versions->stale || (versions->dirty_count && (versions->dirty[versions->dirty_count - 1] == m))) {
+        return;
+    }
+    if (unlikely(versions->dirty_count > matrix->m)) {
+        slm_versions_invalidate(matrix);
+        return;
+    }
+    if (versions->dirty_count == versions->dirty_size) {
+        versions->dirty_size = versions->dirty_size ? 2 * versions->dirty_size : 64;
+        versions->dirty = xrealloc(versions->dirty, versions->dirty_size * sizeof(size_t));
+    }
+    versions->dirty[versions->dirty_count++] = m;
+}
+
+static void slm_snapshot_free(slm_snapshot_t *snapshot)
+{
+    for (size_t k = 0; k < snapshot->retired_count; k++) {
+        xfree(snapshot->retired[k]);
+    }
+    xfree(snapshot->retired);
+    xfree(snapshot);
+}
+
+// Free every node and row of the tree `node`, of `height` levels
+static void slm_snap_tree_free(slm_snap_node_t *node, size_t height)
+{
+    if (!node) {
+        return;
+    }
+    for (size_t k = 0; (height > 1) && (k < (1 << SLM_SNAP_SHIFT)); k++) {
+        slm_snap_tree_free(node->slots[k], height - 1);
+    }
+    if (height == 1) {
+        for (size_t k = 0; k < (1 << SLM_SNAP_SHIFT); k++) {
+            xfree(node->slots[k]);
+        }
+    }
+    xfree(node);
+}
+
+// Free every version that neither a reader nor the matrix holds any more, oldest first, as
+// each relies on the older ones for the nodes and rows they were the last to reach
+static void slm_versions_reclaim(slm_versions_t *versions)
+{
+    while (versions->oldest && !__atomic_load_n(&versions->oldest->refs, __ATOMIC_ACQUIRE)) {
+        slm_snapshot_t *snapshot = versions->oldest;
+        versions->oldest = snapshot->newer;
+        slm_snapshot_free(snapshot);
+    }
+}
+
+static void slm_versions_free(slm_versions_t *versions)
+{
+    if (versions) {
+        // Readers must be done, so the newest version's tree goes along with every version's leftovers
+        slm_snap_tree_free(versions->newest->root, versions->newest->height);
+        for (slm_snapshot_t *snapshot = versions->oldest, *newer = NULL; snapshot; snapshot = newer) {
+            newer = snapshot->newer;
+            slm_snapshot_free(snapshot);
+        }
+        xfree(versions->dirty);
+        xfree(versions);
+    }
+}
+
+slm_matrix_t *slm_matrix_new(void)
+{
+    slm_matrix_t *matrix = xcalloc(1, sizeof(slm_matrix_t));
+    matrix->arena = slm_arena_new();
+    return matrix;
+}
+
+void slm_row_free(slm_vec_t *row)
+{
+    // A private arena releases its elements together with its slabs
+    if (!SLM_POOL || !row->owns_arena) {
+        for (slm_link_t link = row->first, next = SLM_NIL; link; link = next) {
+            slm_elem_t *elem = slm_elem_at(row->arena, link);
+            next = elem->next_col;
+            slm_elem_release(row->arena, elem, link);
+        }
+    }
+    else {
+        slm_stat_add(elem_frees, row->length);
+    }
+    slm_vec_release(row);
+}
+
+void slm_col_free(slm_vec_t *col)
+{
+    if (!SLM_POOL || !col->owns_arena) {
+        for (slm_link_t link = col->first, next = SLM_NIL; link; link = next) {
+            slm_elem_t *elem = slm_elem_at(col->arena, link);
+            next = elem->next_row;
+            slm_elem_release(col->arena, elem, link);
+        }
+    }
+    else {
+        slm_stat_add(elem_frees, col->length);
+    }
+    slm_vec_release(col);
+}
+
+void slm_matrix_free(slm_matrix_t *matrix)
+{
+    // Deferred inserts are dropped rather than merged only to be freed
+    if (matrix->pending) {
+        xfree(matrix->pending->i);
+        xfree(matrix->pending->j);
+        xfree(matrix->pending);
+        matrix->pending = NULL;
+    }
+
+    // Nodes drawn from an arena stay in it until its last owner releases all slabs at once, so owners sharing
+    // it may be freed on different threads without touching its free lists, once no dense index remains
+    if (!SLM_POOL) {
+        for_each_row_in_matrix_safe(row, matrix) {
+            slm_row_free(row);
+        }
+        for_each_col_in_matrix_safe(col, matrix) {
+            col->last = SLM_NIL;
+            col->first = SLM_NIL;
+            slm_col_free(col);
+        }
+    }
+    else if (SLM_DENSE_MIN || SLM_STATS) {
+        slm_stat_add(vec_frees, matrix->m + matrix->n);
+        for_each_row_in_matrix(row, matrix) {
+            slm_stat_add(elem_frees, row->length);
+            xfree(row->dense);
+        }
+        for_each_col_in_matrix(col, matrix) {
+            xfree(col->dense);
+        }
+    }
+
+    slm_arena_release(matrix->arena);
+    slm_hash_free(matrix->hash);
+    slm_components_free(matrix->components);
+    slm_versions_free(matrix->versions);
+    xfree(matrix->rows);
+    xfree(matrix->cols);
+    xfree(matrix);
+}
+
+// Return the slot of the head numbered `k` in the directory table `dir` of `size` slots, or the empty slot ending its probe sequence
+static inline slm_vec_t **slm_dir_slot(slm_vec_t **dir, size_t size, size_t k)
+{
+    const size_t mask = size - 1;
+    size_t s = slm_hash_point(k, 0) & mask;
+    while (dir[s] && (dir[s]->index != k)) {
+        s = (s + 1) & mask;
+    }
+    return &dir[s];
+}
+
+// Number of directory table slots keeping `count` heads below half load
+static size_t slm_dir_table_size(size_t count)
+{
+    size_t size = 16;
+    while (size < 2 * count + 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Build a directory table of `size` slots from the heads held by `dir`, an array or table of `dir_size` slots
+static slm_vec_t **slm_dir_table(slm_vec_t **dir, size_t dir_size, size_t size)
+{
+    slm_vec_t **table = xcalloc(size, sizeof(slm_vec_t *));
+    for (size_t k = 0; k < dir_size; k++) {
+        if (dir[k]) {
+            *slm_dir_slot(table, size, dir[k]->index) = dir[k];
+        }
+    }
+    return table;
+}
+
+// Store `vec` as the head numbered `k` of the directory table `*dir`, already holding `count` heads, or
+// erase that head if `vec` is NULL. Returns whether the table had to grow
+static bool slm_dir_put(slm_vec_t ***dir, size_t *size, size_t count, size_t k, slm_vec_t *vec)
+{
+    if (vec) {
+        const bool grow = 2 * (count + 1) > *size;
+        if (grow) {
+            slm_vec_t **table = slm_dir_table(*dir, *size, 2 * *size);
+            xfree(*dir);
+            *dir = table;
+            *size *= 2;
+        }
+        *slm_dir_slot(*dir, *size, k) = vec;
+        return grow;
+    }
+
+    // As for the point index, later members of the probe sequence shift back rather than leave a tombstone
+    const size_t mask = *size - 1;
+    slm_vec_t **slots = *dir;
+    size_t hole = (size_t)(slm_dir_slot(slots, *size, k) - slots);
+    if (!slots[hole]) {
+        return false;
+    }
+    for (size_t s = (hole + 1) & mask; slots[s]; s = (s + 1) & mask) {
+        const size_t home = slm_hash_point(slots[s]->index, 0) & mask;
+        if (((s - home) & mask) >= ((s - hole) & mask)) {
+            slots[hole] = slots[s];
+            hole = s;
+        }
+    }
+    slots[hole] = NULL;
+    return false;
+}
+
+// Grow the directory `*dir` of `*size` slots to cover number `k`, expecting `count` heads in all, and
+// turn it into a table once an array would leave more than `SLM_DIR_SPARSE` slots per head unused
+// Returns whether the directory was reallocated
+static bool slm_dir_reserve(slm_vec_t ***dir, size_t *size, bool *sparse, size_t k, size_t count)
+{
+    if (unlikely(k > SLM_INDEX_MAX)) {
+        abort();
+    }
+    if (*sparse) {
+        const size_t table_size = slm_dir_table_size(count);
+        if (table_size <= *size) {
+            return false;
+        }
+        slm_vec_t **table = slm_dir_table(*dir, *size, table_size);
+        xfree(*dir);
+        *dir = table;
+        *size = table_size;
+        return true;
+    }
+    if (k < *size) {
+        return false;
+    }
+
+    const size_t size_new = (2 * *size) > (k + 1) ? (2 * *size) : (k + 1);
+    if ((size_new > SLM_DIR_MIN) && (size_new / SLM_DIR_SPARSE > count)) {
+        const size_t table_size = slm_dir_table_size(count);
+        slm_vec_t **table = slm_dir_table(*dir, *size, table_size);
+        xfree(*dir);
+        *dir = table;
+        *size = table_size;
+        *sparse = true;
+        return true;
+    }
+    *dir = xrealloc(*dir, sizeof(slm_vec_t *) * size_new);
+    for (size_t i = *size; i < size_new; i++) {
+        (*dir)[i] = NULL;
+    }
+    *size = size_new;
+    return true;
+}
+
+// Rebuild the directory `*dir` for the heads of list `first`, numbering `count` and all below `span`,
+// as an array or a table, whichever suits their density
+static void slm_dir_fit(slm_vec_t ***dir, size_t *size, bool *sparse, slm_vec_t *first, size_t span, size_t count)
+{
+    xfree(*dir);
+    *sparse = (span > SLM_DIR_MIN) && (span / SLM_DIR_SPARSE > count);
+    *size = *sparse ? slm_dir_table_size(count) : span;
+    *dir = *size ? xcalloc(*size, sizeof(slm_vec_t *)) : NULL;
+    for (slm_vec_t *vec = first; vec; vec = vec->next) {
+        if (*sparse) {
+            *slm_dir_slot(*dir, *size, vec->index) = vec;
+        }
+        else {
+            (*dir)[vec->index] = vec;
+        }
+    }
+}
+
+slm_vec_t *slm_get_row(const slm_matrix_t *matrix, size_t m)
+{
+    slm_matrix_settle(matrix);
+    if (unlikely(matrix->rows_sparse)) {
+        return *slm_dir_slot(matrix->rows, matrix->rows_size, m);
+    }
+    return unlikely(m >= matrix->rows_size) ? NULL : matrix->rows[m];
+}
+
+slm_vec_t *slm_get_col(const slm_matrix_t *matrix, size_t n)
+{
+    slm_matrix_settle(matrix);
+    if (unlikely(matrix->cols_sparse)) {
+        return *slm_dir_slot(matrix->cols, matrix->cols_size, n);
+    }
+    return unlikely(n >= matrix->cols_size) ? NULL : matrix->cols[n];
+}
+
+// Point row number `m` of `matrix`, which must be covered by its directory, at `row`, or at no row if NULL
+static inline void slm_set_row(slm_matrix_t *matrix, size_t m, slm_vec_t *row)
+{
+    if (unlikely(matrix->rows_sparse)) {
+        slm_stat_add(row_resizes, slm_dir_put(&matrix->rows, &matrix->rows_size, matrix->m, m, row));
+    }
+    else {
+        matrix->rows[m] = row;
+    }
+}
+
+// Point column number `n` of `matrix`, which must be covered by its directory, at `col`, or at no column if NULL
+static inline void slm_set_col(slm_matrix_t *matrix, size_t n, slm_vec_t *col)
+{
+    if (unlikely(matrix->cols_sparse)) {
+        slm_stat_add(col_resizes, slm_dir_put(&matrix->cols, &matrix->cols_size, matrix->n, n, col));
+    }
+    else {
+        matrix->cols[n] = col;
+    }
+}
+
+// One past the largest row number in use in `matrix`, bounding arrays indexed by row number
+static inline size_t slm_row_span(const slm_matrix_t *matrix)
+{
+    return matrix->last_row ? matrix->last_row->index + 1 : 0;
+}
+
+// One past the largest column number in use in `matrix`
+static inline size_t slm_col_span(const slm_matrix_t *matrix)
+{
+    return matrix->last_col ? matrix->last_col->index + 1 : 0;
+}
+
+// Number of entries of a scratch array with one per column of `matrix`, as addressed by `slm_col_slot`
+// Bounded by the number of columns, not their numbers, once the directory is a table
+static inline size_t slm_col_slots(const slm_matrix_t *matrix)
+{
+    return matrix->cols_sparse ? matrix->cols_size : slm_col_span(matrix);
+}
+
+// Entry of column `n` of `matrix`, which must exist, in a scratch array of `slm_col_slots` entries:
+// its number, or its slot in the directory if that is a table
+static inline size_t slm_col_slot(const slm_matrix_t *matrix, size_t n)
+{
+    return unlikely(matrix->cols_sparse) ? (size_t)(slm_dir_slot(matrix->cols, matrix->cols_size, n) - matrix->cols) : n;
+}
+
+slm_vec_t *slm_row_dupl(slm_vec_t *row)
+{
+    slm_vec_t *new_row = slm_vec_new();
+    for_each_element_in_row(cell, row) {
+        slm_row_insert(new_row, cell->j);
+    }
+    return new_row;
+}
+
+// Link `vec` into the list `first`...`last` directly after `prev`, or at the head if `prev` is NULL
+static void slm_link_vec(slm_vec_t **first, slm_vec_t **last, slm_vec_t *prev, slm_vec_t *vec)
+{
+    vec->prev = prev;
+    vec->next = prev ? prev->next : *first;
+    if (vec->next) {
+        vec->next->prev = vec;
+    }
+    else {
+        *last = vec;
+    }
+    if (prev) {
+        prev->next = vec;
+    }
+    else {
+        *first = vec;
+    }
+}
+
+// Unlink `vec` from the list `first`...`last`
+static void slm_unlink_vec(slm_vec_t **first, slm_vec_t **last, slm_vec_t *vec)
+{
+    if (!vec->prev) {
+        *first = vec->next;
+    }
+    else {
+        vec->prev->next = vec->next;
+    }
+    if (!vec->next) {
+        *last = vec->prev;
+    }
+    else {
+        vec->next->prev = vec->prev;
+    }
+}
+
+// Return the element at index `k`, or nil if there is none
+static inline slm_link_t slm_dense_get(const slm_dense_t *dense, size_t k)
+{
+    if ((k < dense->base) || (k - dense->base >= dense->span)) {
+        return SLM_NIL;
+    }
+    k -= dense->base;
+    return (dense->bits[k / 64] >> (k % 64) & 1) ? dense->links[k] : SLM_NIL;
+}
+
+// Return the element at the greatest index below `k`, or nil if there is none
+static slm_link_t slm_dense_before(const slm_dense_t *dense, size_t k)
+{
+    if (k <= dense->base) {
+        return SLM_NIL;
+    }
+    k = (k - dense->base < dense->span) ? k - dense->base : dense->span;
+    size_t w = k / 64;
+    uint64_t word = (k % 64) ? dense->bits[w] & (((uint64_t)1 << (k % 64)) - 1) : 0;
+    while (!word) {
+        if (!w--) {
+            return SLM_NIL;
+        }
+        word = dense->bits[w];
+    }
+    return dense->links[w * 64 + 63 - (size_t)__builtin_clzll(word)];
+}
+
+// Index of `elem` along a row (`by_row`) or column
+static inline size_t slm_elem_key(const slm_elem_t *elem, bool by_row)
+{
+    return by_row ? elem->j : elem->i;
+}
+
+#if SLM_DENSE_MIN
+// Allocate a bitset index covering indices `base` up to `base + span`, with no index set
+static slm_dense_t *slm_dense_new(size_t base, size_t span)
+{
+    slm_dense_t *dense = xmalloc(sizeof(slm_dense_t) + span / 64 * sizeof(uint64_t) + span * sizeof(slm_link_t));
+    *dense = (slm_dense_t) {
+        .base = base,
+        .span = span,
+        .bits = (uint64_t *)(dense + 1),
+        .links = (slm_link_t *)((uint64_t *)(dense + 1) + span / 64)
+    };
+    memset(dense->bits, 0, span / 64 * sizeof(uint64_t));
+    return dense;
+}
+
+// Index `vec` once it is long enough and its indices are close enough together
+static void slm_dense_promote(slm_vec_t *vec, bool by_row)
+{
+    const size_t lo = slm_elem_key(slm_elem_at(vec->arena, vec->first), by_row);
+    const size_t hi = slm_elem_key(slm_elem_at(vec->arena, vec->last), by_row);
+    if (hi - lo >= SLM_DENSE_SPAN * vec->length) {
+        return;
+    }
+    const size_t base = lo & ~(size_t)63;
+    vec->dense = slm_dense_new(base, (hi - base + 64) & ~(size_t)63);
+    for (slm_link_t link = vec->first; link;) {
+        const slm_elem_t *elem = slm_elem_at(vec->arena, link);
+        const size_t k = slm_elem_key(elem, by_row) - base;
+        vec->dense->bits[k / 64] |= (uint64_t)1 << (k % 64);
+        vec->dense->links[k] = link;
+        link = by_row ? elem->next_col : elem->next_row;
+    }
+}
+
+// Widen the index of `vec` to cover index `k`, at least doubling it so that runs of
+// appends stay cheap, or drop the index if `vec` is no longer dense
+static bool slm_dense_cover(slm_vec_t *vec, size_t k, bool by_row)
+{
+    slm_dense_t *dense = vec->dense;
+    size_t lo = dense->base;
+    size_t hi = dense->base + dense->span;
+    if ((k >= lo) && (k < hi)) {
+        return true;
+    }
+    const size_t first = slm_elem_key(slm_elem_at(vec->arena, vec->first), by_row);
+    const size_t last = slm_elem_key(slm_elem_at(vec->arena, vec->last), by_row);
+    if (last - first >= 2 * SLM_DENSE_SPAN * vec->length) {
+        xfree(dense);
+        vec->dense = NULL;
+        return false;
+    }
+
+    if (k < lo) {
+        lo = k & ~(size_t)63;
+        lo = (hi - lo < 2 * dense->span) && (hi >= 2 * dense->span) ? hi - 2 * dense->span : lo;
+    }
+    else {
+        hi = (k + 64) & ~(size_t)63;
+        hi = (hi - lo < 2 * dense->span) ? lo + 2 * dense->span : hi;
+    }
+    slm_dense_t *wider = slm_dense_new(lo, hi - lo);
+    memcpy(wider->bits + (dense->base - lo) / 64, dense->bits, dense->span / 64 * sizeof(uint64_t));
+    memcpy(wider->links + (dense->base - lo), dense->links, dense->span * sizeof(slm_link_t));
+    xfree(dense);
+    vec->dense = wider;
+    return true;
+}
+#endif
+
+// Record `link` at index `k` of `vec`, just linked in, keeping any index of `vec` up to date
+static inline void slm_dense_insert(slm_vec_t *vec, size_t k, slm_link_t link, bool by_row)
+{
+#if SLM_DENSE_MIN
+    if (vec->dense) {
+        if (slm_dense_cover(vec, k, by_row)) {
+            k -= vec->dense->base;
+            vec->dense->bits[k / 64] |= (uint64_t)1 << (k % 64);
+            vec->dense->links[k] = link;
+        }
+    }
+    else if (vec->length >= SLM_DENSE_MIN) {
+        slm_dense_promote(vec, by_row);
+    }
+#else
+    (void)vec;
+    (void)k;
+    (void)link;
+    (void)by_row;
+#endif
+}
+
+// Forget index `k` of `vec`, just unlinked, dropping the index of `vec` once it is
+// short or its indices are spread too far apart for its remaining length
+static inline void slm_dense_remove(slm_vec_t *vec, size_t k, bool by_row)
+{
+#if SLM_DENSE_MIN
+    if (!vec->dense) {
+        return;
+    }
+    if ((2 * vec->length < SLM_DENSE_MIN) ||
+        (slm_elem_key(slm_elem_at(vec->arena, vec->last), by_row) -
+         slm_elem_key(slm_elem_at(vec->arena, vec->first), by_row) >= 2 * SLM_DENSE_SPAN * vec->length)) {
+        xfree(vec->dense);
+        vec->dense = NULL;
+        return;
+    }
+    k -= vec->dense->base;
+    vec->dense->bits[k / 64] &= ~((uint64_t)1 << (k % 64));
+#else
+    (void)vec;
+    (void)k;
+    (void)by_row;
+#endif
+}
+
+// Link `elem`, reachable through `link`, into row `row` directly after `prev`, or at the head if `prev` is nil
+static inline void slm_link_into_row(slm_vec_t *row, slm_link_t prev, slm_elem_t *elem, slm_link_t link)
+{
+    slm_arena_t *arena = row->arena;
+    elem->prev_col = prev;
+    elem->next_col = prev ? slm_elem_at(arena, prev)->next_col : row->first;
+    if (elem->next_col) {
+        slm_elem_at(arena, elem->next_col)->prev_col = link;
+    }
+    else {
+        row->last = link;
+    }
+    if (prev) {
+        slm_elem_at(arena, prev)->next_col = link;
+    }
+    else {
+        row->first = link;
+    }
+    row->length++;
+    slm_dense_insert(row, elem->j, link, true);
+}
+
+// Link `elem`, reachable through `link`, into column `col` directly after `prev`, or at the head if `prev` is nil
+static inline void slm_link_into_col(slm_vec_t *col, slm_link_t prev, slm_elem_t *elem, slm_link_t link)
+{
+    slm_arena_t *arena = col->arena;
+    elem->prev_row = prev;
+    elem->next_row = prev ? slm_elem_at(arena, prev)->next_row : col->first;
+    if (elem->next_row) {
+        slm_elem_at(arena, elem->next_row)->prev_row = link;
+    }
+    else {
+        col->last = link;
+    }
+    if (prev) {
+        slm_elem_at(arena, prev)->next_row = link;
+    }
+    else {
+        col->first = link;
+    }
+    col->length++;
+    slm_dense_insert(col, elem->i, link, false);
+}
+
+// Unlink `elem` from row `row`, without releasing it
+static inline void slm_unlink_from_row(slm_vec_t *row, slm_elem_t *elem)
+{
+    slm_arena_t *arena = row->arena;
+    if (!elem->prev_col) {
+        row->first = elem->next_col;
+    }
+    else {
+        slm_elem_at(arena, elem->prev_col)->next_col = elem->next_col;
+    }
+    if (!elem->next_col) {
+        row->last = elem->prev_col;
+    }
+    else {
+        slm_elem_at(arena, elem->next_col)->prev_col = elem->prev_col;
+    }
+    row->length--;
+    slm_dense_remove(row, elem->j, true);
+}
+
+// Unlink `elem` from column `col`, without releasing it
+static inline void slm_unlink_from_col(slm_vec_t *col, slm_elem_t *elem)
+{
+    slm_arena_t *arena = col->arena;
+    if (!elem->prev_row) {
+        col->first = elem->next_row;
+    }
+    else {
+        slm_elem_at(arena, elem->prev_row)->next_row = elem->next_row;
+    }
+    if (!elem->next_row) {
+        col->last = elem->prev_row;
+    }
+    else {
+        slm_elem_at(arena, elem->next_row)->prev_row = elem->prev_row;
+    }
+    col->length--;
+    slm_dense_remove(col, elem->i, false);
+}
+
+// Insert `element`, reachable through `link`, into the row `row` at index (column) `n`
+// Releases `element` and returns NULL if the row already holds column `n`
+static inline slm_elem_t *slm_insert_into_row(slm_vec_t *row, size_t n, slm_elem_t *element, slm_link_t link)
+{
+    slm_arena_t *arena = row->arena;
+    slm_link_t prev = row->last;
+    slm_elem_t *itr = slm_elem_at(arena, prev);
+    if (row->dense && itr && (itr->j >= n)) {
+        if (unlikely(slm_dense_get(row->dense, n) != SLM_NIL)) {
+            slm_elem_release(arena, element, link);
+            return NULL;
+        }
+        prev = slm_dense_before(row->dense, n);
+    }
+    else if (itr && (itr->j >= n)) {
+        // Not an append, so find the last element before column `n`
+        prev = SLM_NIL;
+        slm_link_t cur = row->first;
+        itr = slm_elem_at(arena, cur);
+        size_t steps = 0;
+        while (itr->j < n) {
+            prev = cur;
+            cur = itr->next_col;
+            itr = slm_elem_at(arena, cur);
+            steps++;
+        }
+        slm_stat_add(row_scan_steps, steps);
+        if (unlikely(itr->j == n)) {
+            slm_elem_release(arena, element, link);
+            return NULL;
+        }
+    }
+    element->j = n;
+    slm_link_into_row(row, prev, element, link);
+    return element;
+}
+
+// Insert `element`, reachable through `link`, into the column `col` at index (row) `m`
+// Releases `element` and returns NULL if the column already holds row `m`
+static inline slm_elem_t *slm_insert_into_col(slm_vec_t *col, size_t m, slm_elem_t *element, slm_link_t link)
+{
+    slm_arena_t *arena = col->arena;
+    slm_link_t prev = col->last;
+    slm_elem_t *itr = slm_elem_at(arena, prev);
+    if (col->dense && itr && (itr->i >= m)) {
+        if (unlikely(slm_dense_get(col->dense, m) != SLM_NIL)) {
+            slm_elem_release(arena, element, link);
+            return NULL;
+        }
+        prev = slm_dense_before(col->dense, m);
+    }
+    else if (itr && (itr->i >= m)) {
+        // Not an append, so find the last element before row `m`
+        prev = SLM_NIL;
+        slm_link_t cur = col->first;
+        itr = slm_elem_at(arena, cur);
+        size_t steps = 0;
+        while (itr->i < m) {
+            prev = cur;
+            cur = itr->next_row;
+            itr = slm_elem_at(arena, cur);
+            steps++;
+        }
+        slm_stat_add(col_scan_steps, steps);
+        if (unlikely(itr->i == m)) {
+            slm_elem_release(arena, element, link);
+            return NULL;
+        }
+    }
+    element->i = m;
+    slm_link_into_col(col, prev, element, link);
+    return element;
+}
+
+slm_elem_t *slm_row_insert(slm_vec_t *row, size_t n)
+{
+    slm_link_t link;
+    slm_elem_t *element = slm_elem_alloc(row->arena, &link);
+    return slm_insert_into_row(row, n, element, link);
+}
+
+void slm_row_remove(slm_vec_t *row, size_t index)
+{
+    if (row->dense) {
+        const slm_link_t link = slm_dense_get(row->dense, index);
+        if (link) {
+            slm_elem_t *cell = slm_elem_at(row->arena, link);
+            slm_unlink_from_row(row, cell);
+            slm_elem_release(row->arena, cell, link);
+        }
+        return;
+    }
+
+    slm_link_t link = row->first;
+    slm_elem_t *cell = slm_elem_at(row->arena, link);
+    for (; cell && cell->j < index; link = cell->next_col, cell = slm_elem_at(row->arena, link));
+    if (cell && (cell->j == index)) {
+        slm_unlink_from_row(row, cell);
+        slm_elem_release(row->arena, cell, link);
+    }
+}
+
+// Count the indices held by both `a` and `b`, as rows (`by_row`) or as columns
+static size_t slm_vec_intersection_count(const slm_vec_t *a, const slm_vec_t *b, bool by_row)
+{
+    size_t count = 0;
+    if (a->dense && b->dense) {
+        // Both indices start on a word boundary, so they overlap in whole words
+        const slm_dense_t *x = a->dense;
+        const slm_dense_t *y = b->dense;
+        const size_t lo = x->base > y->base ? x->base : y->base;
+        const size_t hi = x->base + x->span < y->base + y->span ? x->base + x->span : y->base + y->span;
+        if (lo < hi) {
+            const uint64_t *xw = x->bits + (lo - x->base) / 64;
+            const uint64_t *yw = y->bits + (lo - y->base) / 64;
+            for (size_t w = 0; w < (hi - lo) / 64; w++) {
+                count += (size_t)__builtin_popcountll(xw[w] & yw[w]);
+            }
+        }
+        return count;
+    }
+
+    if (b->dense) {
+        const slm_vec_t *swap = a;
+        a = b;
+        b = swap;
+    }
+    const slm_elem_t *y = slm_elem_at(b->arena, b->first);
+    if (a->dense) {
+        // Probe the index of the dense vector for every element of the other
+        for (; y; y = slm_elem_at(b->arena, by_row ? y->next_col : y->next_row)) {
+            count += slm_dense_get(a->dense, slm_elem_key(y, by_row)) != SLM_NIL;
+        }
+        return count;
+    }
+
+    const slm_elem_t *x = slm_elem_at(a->arena, a->first);
+    while (x && y) {
+        const size_t kx = slm_elem_key(x, by_row);
+        const size_t ky = slm_elem_key(y, by_row);
+        if (kx <= ky) {
+            x = slm_elem_at(a->arena, by_row ? x->next_col : x->next_row);
+        }
+        if (ky <= kx) {
+            y = slm_elem_at(b->arena, by_row ? y->next_col : y->next_row);
+        }
+        count += kx == ky;
+    }
+    return count;
+}
+
+size_t slm_row_intersection_count(const slm_vec_t *a, const slm_vec_t *b)
+{
+    return slm_vec_intersection_count(a, b, true);
+}
+
+size_t slm_row_union_count(const slm_vec_t *a, const slm_vec_t *b)
+{
+    return a->length + b->length - slm_vec_intersection_count(a, b, true);
+}
+
+size_t slm_col_intersection_count(const slm_vec_t *a, const slm_vec_t *b)
+{
+    return slm_vec_intersection_count(a, b, false);
+}
+
+size_t slm_col_union_count(const slm_vec_t *a, const slm_vec_t *b)
+{
+    return a->length + b->length - slm_vec_intersection_count(a, b, false);
+}
+
+void slm_matrix_resize_row(slm_matrix_t *matrix, size_t m)
+{
+    slm_stat_add(row_resizes, slm_dir_reserve(&matrix->rows, &matrix->rows_size, &matrix->rows_sparse, m, matrix->m + 1));
+}
+
+void slm_matrix_resize_col(slm_matrix_t *matrix, size_t n)
+{
+    slm_stat_add(col_resizes, slm_dir_reserve(&matrix->cols, &matrix->cols_size, &matrix->cols_sparse, n, matrix->n + 1));
+}
+
+void slm_matrix_resize(slm_matrix_t *matrix, size_t m, size_t n)
+{
+    if (m >= matrix->rows_size) {
+        slm_matrix_resize_row(matrix, m);
+    }
+    if (n >= matrix->cols_size) {
+        slm_matrix_resize_col(matrix, n);
+    }
+}
+
+// Cover row `m` and column `n` of `matrix`, about to hold `rows` rows and `cols` columns, so that
+// bulk builders pick the directory to suit the whole matrix rather than its first few rows
+static void slm_matrix_reserve(slm_matrix_t *matrix, size_t m, size_t n, size_t rows, size_t cols)
+{
+    slm_stat_add(row_resizes, slm_dir_reserve(&matrix->rows, &matrix->rows_size, &matrix->rows_sparse, m, rows));
+    slm_stat_add(col_resizes, slm_dir_reserve(&matrix->cols, &matrix->cols_size, &matrix->cols_sparse, n, cols));
+}
+
+slm_matrix_t *slm_matrix_dupl(const slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    slm_matrix_t *dupl = slm_matrix_new();
+    if (matrix->last_row) {
+        slm_matrix_reserve(dupl, matrix->last_row->index, matrix->last_col->index, matrix->m, matrix->n);
+        for_each_row_in_matrix(row, matrix) {
+            for_each_element_in_row(cell, row) {
+                slm_matrix_insert(dupl, cell->i, cell->j);
+            }
+        }
+    }
+    return dupl;
+}
+
+// Add a new row, `row` to `matrix` at index `m`
+static inline void slm_add_row(slm_matrix_t *matrix, slm_vec_t *row, size_t m)
+{
+    if (!matrix->last_row) {
+        row->index = m;
+        matrix->first_row = row;
+        matrix->last_row = row;
+        row->next = NULL;
+        row->prev = NULL;
+        matrix->m++;
+    }
+    else if (matrix->last_row->index < m) {
+        row->index = m;
+        matrix->last_row->next = row;
+        row->prev = matrix->last_row;
+        matrix->last_row = row;
+        row->next = NULL;
+        matrix->m++;
+    }
+    else if (matrix->first_row->index > m) {
+        row->index = m;
+        matrix->first_row->prev = row;
+        row->next = matrix->first_row;
+        matrix->first_row = row;
+        row->prev = NULL;
+        matrix->m++;
+    }
+    else {
+        slm_vec_t *itr = matrix->first_row;
+        size_t steps = 0;
+        for (; itr->index < m; itr = itr->next) {
+            steps++;
+        }
+        slm_stat_add(row_list_steps, steps);
+        if (itr->index > m) {
+            row->index = m;
+            itr = itr->prev;
+            itr->next->prev = row;
+            row->next = itr->next;
+            itr->next = row;
+            row->prev = itr;
+            matrix->m++;
+        }
+    }
+}
+
+// Add a new column, `col` to `matrix` at index `n`
+static inline void slm_add_col(slm_matrix_t *matrix, slm_vec_t *col, size_t n)
+{
+    if (!matrix->last_col) {
+        col->index = n;
+        matrix->first_col = col;
+        matrix->last_col = col;
+        col->next = NULL;
+        col->prev = NULL;
+        matrix->n++;
+    }
+    else if (matrix->last_col->index < n) {
+        col->index = n;
+        matrix->last_col->next = col;
+        col->prev = matrix->last_col;
+        matrix->last_col = col;
+        col->next = NULL;
+        matrix->n++;
+    }
+    else if (matrix->first_col->index > n) {
+        col->index = n;
+        matrix->first_col->prev = col;
+        col->next = matrix->first_col;
+        matrix->first_col = col;
+        col->prev = NULL;
+        matrix->n++;
+    }
+    else {
+        slm_vec_t *itr = matrix->first_col;
+        size_t steps = 0;
+        for (; itr->index < n; itr = itr->next) {
+            steps++;
+        }
+        slm_stat_add(col_list_steps, steps);
+        if (itr->index > n) {
+            col->index = n;
+            itr = itr->prev;
+            itr->next->prev = col;
+            col->next = itr->next;
+            itr->next = col;
+            col->prev = itr;
+            matrix->n++;
+        }
+    }
+}
+
+void slm_matrix_insert(slm_matrix_t *matrix, size_t m, size_t n)
+{
+    if (matrix->deferred) {
+        slm_pending_t *pending = matrix->pending;
+        if (!pending) {
+            pending = xcalloc(1, sizeof(slm_pending_t));
+            matrix->pending = pending;
+        }
+        if (pending->count == pending->size) {
+            pending->size = pending->size ? 2 * pending->size : 1024;
+            pending->i = xrealloc(pending->i, pending->size * sizeof(size_t));
+            pending->j = xrealloc(pending->j, pending->size * sizeof(size_t));
+        }
+        pending->i[pending->count] = m;
+        pending->j[pending->count] = n;
+        pending->count++;
+        return;
+    }
+
+    slm_components_prepare(matrix);
+    if ((m >= matrix->rows_size) || (n >= matrix->cols_size)) {
+        slm_matrix_resize(matrix, m, n);
+    }
+
+    if (matrix->hash && slm_hash_slot(matrix->hash, m, n)->link) {
+        return;
+    }
+
+    slm_vec_t *row = slm_get_row(matrix, m);
+    if (!row) {
+        row = slm_vec_alloc(matrix->arena);
+        row->index = m;
+        slm_set_row(matrix, m, row);
+        slm_add_row(matrix, row, m);
+    }
+
+    slm_vec_t *col = slm_get_col(matrix, n);
+    if (!col) {
+        col = slm_vec_alloc(matrix->arena);
+        col->index = n;
+        slm_set_col(matrix, n, col);
+        slm_add_col(matrix, col, n);
+    }
+
+    slm_link_t link;
+    slm_elem_t *element = slm_elem_alloc(matrix->arena, &link);
+    if (slm_insert_into_row(row, n, element, link)) {
+        slm_insert_into_col(col, m, element, link);
+        if (matrix->hash) {
+            slm_hash_put(matrix->hash, m, n, link);
+        }
+        if (matrix->components) {
+            slm_components_link(matrix->components, m, n);
+        }
+        slm_versions_touch(matrix, m);
+    }
+}
+
+// Append a new row at index `m`, past every existing row
+static slm_vec_t *slm_append_row(slm_matrix_t *matrix, size_t m)
+{
+    slm_vec_t *row = slm_vec_alloc(matrix->arena);
+    row->index = m;
+    slm_set_row(matrix, m, row);
+    slm_link_vec(&matrix->first_row, &matrix->last_row, matrix->last_row, row);
+    matrix->m++;
+    return row;
+}
+
+// Append a new column at index `n`, past every existing column
+static slm_vec_t *slm_append_col(slm_matrix_t *matrix, size_t n)
+{
+    slm_vec_t *col = slm_vec_alloc(matrix->arena);
+    col->index = n;
+    slm_set_col(matrix, n, col);
+    slm_link_vec(&matrix->first_col, &matrix->last_col, matrix->last_col, col);
+    matrix->n++;
+    return col;
+}
+
+// Append a new element at the tail of both `row` and `col`, past every existing element of each
+static void slm_append_elem(slm_matrix_t *matrix, slm_vec_t *row, slm_vec_t *col)
+{
+    slm_components_prepare(matrix);
+    slm_link_t link;
+    slm_elem_t *elem = slm_elem_alloc(matrix->arena, &link);
+    elem->i = row->index;
+    elem->j = col->index;
+    slm_link_into_row(row, row->last, elem, link);
+    slm_link_into_col(col, col->last, elem, link);
+    if (matrix->hash) {
+        slm_hash_put(matrix->hash, row->index, col->index, link);
+    }
+    if (matrix->components) {
+        slm_components_link(matrix->components, row->index, col->index);
+    }
+    slm_versions_touch(matrix, row->index);
+}
+
+// Run `worker` over every task of the array `tasks`, each `size` bytes, the
+// first on the calling thread and the rest on threads of their own
+static void slm_run_tasks(void *(*worker)(void *), void *tasks, size_t size, size_t count)
+{
+    pthread_t *threads = xmalloc(count * sizeof(pthread_t));
+    size_t spawned = 1;
+    for (; spawned < count; spawned++) {
+        if (pthread_create(&threads[spawned], NULL, worker, (char *)tasks + spawned * size)) {
+            break;
+        }
+    }
+    worker(tasks);
+    // Any task without a thread of its own runs here as well
+    for (size_t t = spawned; t < count; t++) {
+        worker((char *)tasks + t * size);
+    }
+    for (size_t t = 1; t < spawned; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    xfree(threads);
+}
+
+// Split `count` rows into `parts` ranges of near-equal element count, given the
+// cumulative element counts `prefix` (of length `count + 1`). Range `t` runs
+// from `bounds[t]` up to `bounds[t + 1]`
+static void slm_split_rows(size_t *bounds, size_t parts, const size_t *prefix, size_t count)
+{
+    bounds[0] = 0;
+    for (size_t t = 0; t < parts; t++) {
+        const size_t target = prefix[count] * (t + 1) / parts;
+        size_t lo = bounds[t];
+        size_t hi = count;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (prefix[mid + 1] <= target) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        bounds[t + 1] = (t + 1 == parts) ? count : lo;
+    }
+}
+
+// Entry of a coordinate list, along with the element created for it
+typedef struct slm_coo_t {
+    size_t i;
+    size_t j;
+    slm_link_t link;
+} slm_coo_t;
+
+// Stable LSD radix sort of `coo` by row (`by_row`) or column index, using `tmp` as scratch space
+// Returns whichever of the two buffers holds the sorted entries
+static slm_coo_t *slm_coo_sort(slm_coo_t *coo, slm_coo_t *tmp, size_t count, bool by_row)
+{
+    size_t bits = 0;
+    for (size_t k = 0; k < count; k++) {
+        bits |= by_row ? coo[k].i : coo[k].j;
+    }
+
+    for (size_t shift = 0; (shift < 8 * sizeof(size_t)) && (bits >> shift); shift += 8) {
+        size_t hist[256] = { 0 };
+        for (size_t k = 0; k < count; k++) {
+            hist[((by_row ? coo[k].i : coo[k].j) >> shift) & 0xff]++;
+        }
+        if (hist[((by_row ? coo[0].i : coo[0].j) >> shift) & 0xff] == count) {
+            continue;
+        }
+        for (size_t d = 0, sum = 0; d < 256; d++) {
+            const size_t c = hist[d];
+            hist[d] = sum;
+            sum += c;
+        }
+        for (size_t k = 0; k < count; k++) {
+            tmp[hist[((by_row ? coo[k].i : coo[k].j) >> shift) & 0xff]++] = coo[k];
+        }
+        slm_coo_t *swap = coo;
+        coo = tmp;
+        tmp = swap;
+    }
+    return coo;
+}
+
+// Find or create the row (`by_row`) or column of each run of equal numbers in `coo`, sorted by that number,
+// storing where the runs start, and the start past the last, to `starts` and their vectors to `vecs`
+// Returns the number of runs
+static size_t slm_coo_runs(slm_matrix_t *matrix, const slm_coo_t *coo, size_t count, bool by_row,
+                           size_t *starts, slm_vec_t **vecs)
+{
+    slm_vec_t **first = by_row ? &matrix->first_row : &matrix->first_col;
+    slm_vec_t **last = by_row ? &matrix->last_row : &matrix->last_col;
+    slm_vec_t *hdr = NULL;
+    size_t runs = 0;
+    for (size_t k = 0; k < count; k++) {
+        const size_t x = by_row ? coo[k].i : coo[k].j;
+        if (k && (x == (by_row ? coo[k - 1].i : coo[k - 1].j))) {
+            continue;
+        }
+        slm_vec_t *next = NULL;
+        while ((next = hdr ? hdr->next : *first) && (next->index < x)) {
+            hdr = next;
+        }
+        slm_vec_t *vec = by_row ? slm_get_row(matrix, x) : slm_get_col(matrix, x);
+        if (!vec) {
+            vec = slm_vec_alloc(matrix->arena);
+            vec->index = x;
+            if (by_row) {
+                slm_set_row(matrix, x, vec);
+                matrix->m++;
+            }
+            else {
+                slm_set_col(matrix, x, vec);
+                matrix->n++;
+            }
+            slm_link_vec(first, last, hdr, vec);
+        }
+        hdr = vec;
+        starts[runs] = k;
+        vecs[runs++] = vec;
+    }
+    starts[runs] = count;
+    return runs;
+}
+
+// Runs of a coordinate list that one thread links into their rows or columns
+typedef struct slm_coo_task_t {
+    slm_arena_t *arena;
+    slm_coo_t *coo;
+    const slm_link_t *spare; // element set aside for each entry, if linking rows over several threads
+    const size_t *starts;
+    slm_vec_t *const *vecs;
+    size_t begin; // first run
+    size_t end; // run past the last
+} slm_coo_task_t;
+
+// Merge the entries of each run into its row, advancing one cursor through the elements of the row, and give
+// each entry new to it the element set aside for it, leaving entries already present without one
+static void *slm_coo_row_worker(void *arg)
+{
+    slm_coo_task_t *task = arg;
+    slm_arena_t *arena = task->arena;
+    slm_coo_t *coo = task->coo;
+    for (size_t r = task->begin; r < task->end; r++) {
+        slm_vec_t *row = task->vecs[r];
+        slm_link_t prev = SLM_NIL;
+        for (size_t k = task->starts[r]; k < task->starts[r + 1]; k++) {
+            slm_link_t cur = SLM_NIL;
+            slm_elem_t *cell = NULL;
+            while ((cur = prev ? slm_elem_at(arena, prev)->next_col : row->first) &&
+                   ((cell = slm_elem_at(arena, cur))->j < coo[k].j)) {
+                prev = cur;
+            }
+            if (cur && (cell->j == coo[k].j)) {
+                prev = cur;
+                continue;
+            }
+            slm_elem_t *elem = NULL;
+            if (task->spare) {
+                coo[k].link = task->spare[k];
+                elem = slm_elem_at(arena, coo[k].link);
+            }
+            else {
+                elem = slm_elem_alloc(arena, &coo[k].link);
+            }
+            elem->i = coo[k].i;
+            elem->j = coo[k].j;
+            slm_link_into_row(row, prev, elem, coo[k].link);
+            prev = coo[k].link;
+        }
+    }
+    return NULL;
+}
+
+// Merge the new elements of each run into its column likewise
+static void *slm_coo_col_worker(void *arg)
+{
+    slm_coo_task_t *task = arg;
+    slm_arena_t *arena = task->arena;
+    const slm_coo_t *coo = task->coo;
+    for (size_t r = task->begin; r < task->end; r++) {
+        slm_vec_t *col = task->vecs[r];
+        slm_link_t prev = SLM_NIL;
+        for (size_t k = task->starts[r]; k < task->starts[r + 1]; k++) {
+            if (!coo[k].link) {
+                continue;
+            }
+            slm_link_t cur = SLM_NIL;
+            while ((cur = prev ? slm_elem_at(arena, prev)->next_row : col->first) &&
+                   (slm_elem_at(arena, cur)->i < coo[k].i)) {
+                prev = cur;
+            }
+            slm_link_into_col(col, prev, slm_elem_at(arena, coo[k].link), coo[k].link);
+            prev = coo[k].link;
+        }
+    }
+    return NULL;
+}
+
+// Link the entries of `coo` into their rows (`by_row`) or columns over up to `threads` threads,
+// each taking a range of the `runs` runs found by `slm_coo_runs` holding about as many entries
+static void slm_coo_link(slm_matrix_t *matrix, slm_coo_t *coo, const slm_link_t *spare, const size_t *starts,
+                         slm_vec_t *const *vecs, size_t runs, bool by_row, size_t threads)
+{
+    threads = threads < runs ? threads : runs;
+    threads = threads ? threads : 1;
+    size_t *bounds = xmalloc((threads + 1) * sizeof(size_t));
+    slm_split_rows(bounds, threads, starts, runs);
+    slm_coo_task_t *tasks = xmalloc(threads * sizeof(slm_coo_task_t));
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t] = (slm_coo_task_t) {
+            .arena = matrix->arena,
+            .coo = coo,
+            .spare = spare,
+            .starts = starts,
+            .vecs = vecs,
+            .begin = bounds[t],
+            .end = bounds[t + 1]
+        };
+    }
+    slm_run_tasks(by_row ? slm_coo_row_worker : slm_coo_col_worker, tasks, sizeof(slm_coo_task_t), threads);
+    xfree(tasks);
+    xfree(bounds);
+}
+
+void slm_matrix_insert_coo(slm_matrix_t *matrix, const size_t *i, const size_t *j, size_t nnz)
+{
+    slm_matrix_insert_coo_parallel(matrix, i, j, nnz, 1);
+}
+
+void slm_matrix_insert_coo_parallel(slm_matrix_t *matrix, const size_t *i, const size_t *j, size_t nnz, size_t threads)
+{
+    slm_matrix_settle(matrix);
+    if (!nnz) {
+        return;
+    }
+    slm_components_prepare(matrix);
+
+    slm_coo_t *buf = xmalloc(2 * nnz * sizeof(slm_coo_t));
+    size_t max_i = 0;
+    size_t max_j = 0;
+    for (size_t k = 0; k < nnz; k++) {
+        buf[k] = (slm_coo_t) {
+            .i = i[k],
+            .j = j[k],
+            .link = SLM_NIL
+        };
+        max_i = i[k] > max_i ? i[k] : max_i;
+        max_j = j[k] > max_j ? j[k] : max_j;
+    }
+
+    // Row-major order, with duplicate entries dropped. Each pass leaves equal numbers adjacent,
+    // so the rows and columns that are new to `matrix` are counted on the way to reserve for them
+    slm_coo_t *coo = slm_coo_sort(buf, buf + nnz, nnz, false);
+    size_t new_cols = 0;
+    for (size_t k = 0; k < nnz; k++) {
+        new_cols += (!k || (coo[k].j != coo[k - 1].j)) && !slm_get_col(matrix, coo[k].j);
+    }
+    coo = slm_coo_sort(coo, coo == buf ? buf + nnz : buf, nnz, true);
+    size_t new_rows = 0;
+    for (size_t k = 0; k < nnz; k++) {
+        new_rows += (!k || (coo[k].i != coo[k - 1].i)) && !slm_get_row(matrix, coo[k].i);
+    }
+    slm_matrix_reserve(matrix, max_i, max_j, matrix->m + new_rows, matrix->n + new_cols);
+
+    size_t count = 1;
+    for (size_t k = 1; k < nnz; k++) {
+        if ((coo[k].i != coo[count - 1].i) || (coo[k].j != coo[count - 1].j)) {
+            coo[count++] = coo[k];
+        }
+    }
+
+    // Rows, columns, and, for more than one thread, elements are all drawn from the arena up front, so that threads
+    // need only link them: each merges a range of whole rows, then a range of whole columns, touching no list of another
+    size_t *starts = xmalloc((count + 1) * sizeof(size_t));
+    slm_vec_t **vecs = xmalloc(count * sizeof(slm_vec_t *));
+    slm_link_t *spare = NULL;
+    if (threads > 1) {
+        spare = xmalloc(count * sizeof(slm_link_t));
+        for (size_t k = 0; k < count; k++) {
+            slm_elem_alloc(matrix->arena, &spare[k]);
+        }
+    }
+    size_t runs = slm_coo_runs(matrix, coo, count, true, starts, vecs);
+    slm_coo_link(matrix, coo, spare, starts, vecs, runs, true, threads);
+
+    // Entries already present got no element, so their spares go back to the arena
+    for (size_t k = 0; k < count; k++) {
+        if (!coo[k].link) {
+            if (spare) {
+                slm_elem_release(matrix->arena, slm_elem_at(matrix->arena, spare[k]), spare[k]);
+            }
+            continue;
+        }
+        if (matrix->hash) {
+            slm_hash_put(matrix->hash, coo[k].i, coo[k].j, coo[k].link);
+        }
+        slm_versions_touch(matrix, coo[k].i);
+    }
+
+    // Column-major order is a stable sort away; merge new elements into their columns likewise
+    coo = slm_coo_sort(coo, coo == buf ? buf + nnz : buf, count, false);
+    runs = slm_coo_runs(matrix, coo, count, false, starts, vecs);
+    slm_coo_link(matrix, coo, NULL, starts, vecs, runs, false, threads);
+    xfree(starts);
+    xfree(vecs);
+    xfree(spare);
+
+    if (matrix->components) {
+        for (size_t k = 0; k < count; k++) {
+            if (coo[k].link) {
+                slm_components_link(matrix->components, coo[k].i, coo[k].j);
+            }
+        }
+    }
+
+    xfree(buf);
+}
+
+slm_matrix_t *slm_matrix_from_coo(const size_t *i, const size_t *j, size_t nnz)
+{
+    slm_matrix_t *matrix = slm_matrix_new();
+    slm_matrix_insert_coo(matrix, i, j, nnz);
+    return matrix;
+}
+
+void slm_matrix_defer(slm_matrix_t *matrix, bool defer)
+{
+    if (!defer) {
+        slm_matrix_flush(matrix);
+    }
+    matrix->deferred = defer;
+}
+
+// Serializes merging deferred inserts, which `const` readers on any number of threads may start at once
+static pthread_mutex_t slm_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Matrix whose log this thread is merging, whose own reads during the merge must not wait on it
+static _Thread_local const slm_matrix_t *slm_flushing;
+
+void slm_matrix_flush(slm_matrix_t *matrix)
+{
+    if (slm_flushing == matrix || __atomic_load_n(&matrix->pending, __ATOMIC_ACQUIRE) == NULL) {
+        return;
+    }
+    // The log is cleared only once merged, so readers finding it empty never see a half-merged matrix
+    pthread_mutex_lock(&slm_flush_lock);
+    slm_pending_t *pending = matrix->pending;
+    if (pending) {
+        slm_flushing = matrix;
+        slm_matrix_insert_coo(matrix, pending->i, pending->j, pending->count);
+        slm_flushing = NULL;
+        __atomic_store_n(&matrix->pending, NULL, __ATOMIC_RELEASE);
+        xfree(pending->i);
+        xfree(pending->j);
+        xfree(pending);
+    }
+    pthread_mutex_unlock(&slm_flush_lock);
+}
+
+slm_ingest_t *slm_ingest_new(slm_matrix_t *matrix, size_t shards)
+{
+    slm_ingest_t *ingest = xcalloc(1, sizeof(slm_ingest_t));
+    ingest->matrix = matrix;
+    ingest->count = shards ? shards : 1;
+    ingest->shards = xcalloc(ingest->count, sizeof(slm_ingest_shard_t));
+    for (size_t s = 0; s < ingest->count; s++) {
+        pthread_mutex_init(&ingest->shards[s].lock, NULL);
+    }
+    pthread_mutex_init(&ingest->merge, NULL);
+    return ingest;
+}
+
+// Number of the calling thread, handed out on first use
+static size_t slm_thread_number(void)
+{
+    static size_t threads;
+    static _Thread_local size_t number;
+    if (!number) {
+        number = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+    }
+    return number - 1;
+}
+
+// Merge the elements buffered by every shard of `ingest` into its matrix, with `ingest->merge` held
+static void slm_ingest_merge(slm_ingest_t *ingest)
+{
+    // Take each buffer as it stands, so that appends carry on into fresh ones during the merge
+    slm_ingest_shard_t *taken = xmalloc(ingest->count * sizeof(slm_ingest_shard_t));
+    size_t total = 0;
+    for (size_t s = 0; s < ingest->count; s++) {
+        slm_ingest_shard_t *shard = &ingest->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        taken[s] = *shard;
+        shard->i = NULL;
+        shard->j = NULL;
+        shard->count = 0;
+        shard->size = 0;
+        pthread_mutex_unlock(&shard->lock);
+        total += taken[s].count;
+    }
+
+    if (total) {
+        size_t *i = xmalloc(total * sizeof(size_t));
+        size_t *j = xmalloc(total * sizeof(size_t));
+        size_t k = 0;
+        for (size_t s = 0; s < ingest->count; s++) {
+            if (taken[s].count) {
+                memcpy(i + k, taken[s].i, taken[s].count * sizeof(size_t));
+                memcpy(j + k, taken[s].j, taken[s].count * sizeof(size_t));
+                k += taken[s].count;
+            }
+        }
+        slm_matrix_insert_coo_parallel(ingest->matrix, i, j, total, ingest->count);
+        xfree(i);
+        xfree(j);
+    }
+
+    for (size_t s = 0; s < ingest->count; s++) {
+        xfree(taken[s].i);
+        xfree(taken[s].j);
+    }
+    xfree(taken);
+}
+
+void slm_ingest_insert(slm_ingest_t *ingest, size_t m, size_t n)
+{
+    slm_ingest_shard_t *shard = &ingest->shards[slm_thread_number() % ingest->count];
+    pthread_mutex_lock(&shard->lock);
+    if (shard->count == shard->size) {
+        shard->size = shard->size ? 2 * shard->size : 1024;
+        shard->i = xrealloc(shard->i, shard->size * sizeof(size_t));
+        shard->j = xrealloc(shard->j, shard->size * sizeof(size_t));
+    }
+    shard->i[shard->count] = m;
+    shard->j[shard->count] = n;
+    const size_t count = ++shard->count;
+    pthread_mutex_unlock(&shard->lock);
+
+    // A full shard merges unless another thread already is; one far past full waits its turn instead
+    if (count >= SLM_INGEST_BATCH) {
+        if ((count >= 4 * SLM_INGEST_BATCH) ? !pthread_mutex_lock(&ingest->merge) : !pthread_mutex_trylock(&ingest->merge)) {
+            slm_ingest_merge(ingest);
+            pthread_mutex_unlock(&ingest->merge);
+        }
+    }
+}
+
+void slm_ingest_flush(slm_ingest_t *ingest)
+{
+    pthread_mutex_lock(&ingest->merge);
+    slm_ingest_merge(ingest);
+    pthread_mutex_unlock(&ingest->merge);
+}
+
+slm_snapshot_t *slm_ingest_snapshot(slm_ingest_t *ingest)
+{
+    pthread_mutex_lock(&ingest->merge);
+    slm_ingest_merge(ingest);
+    slm_snapshot_t *snapshot = slm_matrix_snapshot(ingest->matrix);
+    pthread_mutex_unlock(&ingest->merge);
+    return snapshot;
+}
+
+void slm_ingest_free(slm_ingest_t *ingest)
+{
+    slm_ingest_flush(ingest);
+    for (size_t s = 0; s < ingest->count; s++) {
+        pthread_mutex_destroy(&ingest->shards[s].lock);
+    }
+    pthread_mutex_destroy(&ingest->merge);
+    xfree(ingest->shards);
+    xfree(ingest);
+}
+
+// Remove row `vec` of `matrix`, or column `vec` if not `rows`, along with its elements and every column / row
+// they leave empty, keeping the point hash, tracked components, and snapshot history in step
+static void slm_matrix_remove_vec(slm_matrix_t *matrix, slm_vec_t *vec, bool rows)
+{
+    if (matrix->components) {
+        slm_components_invalidate(matrix->components, 2 * vec->index + !rows);
+    }
+    if (rows) {
+        slm_versions_touch(matrix, vec->index);
+    }
+    for (slm_link_t link = vec->first, next = SLM_NIL; link; link = next) {
+        slm_elem_t *elem = slm_elem_at(matrix->arena, link);
+        slm_vec_t *cross = NULL;
+        if (rows) {
+            next = elem->next_col;
+            cross = slm_get_col(matrix, elem->j);
+            slm_unlink_from_col(cross, elem);
+        }
+        else {
+            next = elem->next_row;
+            cross = slm_get_row(matrix, elem->i);
+            slm_unlink_from_row(cross, elem);
+            slm_versions_touch(matrix, elem->i);
+        }
+        if (matrix->hash) {
+            slm_hash_remove(matrix->hash, elem->i, elem->j);
+        }
+        slm_elem_release(matrix->arena, elem, link);
+
+        if (!cross->first) {
+            slm_matrix_remove_vec(matrix, cross, !rows);
+        }
+    }
+    if (rows) {
+        slm_set_row(matrix, vec->index, NULL);
+        slm_unlink_vec(&matrix->first_row, &matrix->last_row, vec);
+        matrix->m--;
+    }
+    else {
+        slm_set_col(matrix, vec->index, NULL);
+        slm_unlink_vec(&matrix->first_col, &matrix->last_col, vec);
+        matrix->n--;
+    }
+    slm_vec_release(vec);
+}
+
+void slm_matrix_remove_row(slm_matrix_t *matrix, size_t m)
+{
+    slm_matrix_settle(matrix);
+    slm_vec_t *row = slm_get_row(matrix, m);
+    if (row) {
+        slm_matrix_remove_vec(matrix, row, true);
+    }
+}
+
+void slm_matrix_remove_col(slm_matrix_t *matrix, size_t n)
+{
+    slm_matrix_settle(matrix);
+    slm_vec_t *col = slm_get_col(matrix, n);
+    if (col) {
+        slm_matrix_remove_vec(matrix, col, false);
+    }
+}
+
+// Store the distinct numbers among the `k` of `idx` naming a row of `matrix`, or a column if `cols`, to
+// `order` in ascending order, returning how many there are
+static size_t slm_index_order(const slm_matrix_t *matrix, bool cols, const size_t *idx, size_t k, size_t *order)
+{
+    size_t count = 0;
+    for (size_t x = 0; x < k; x++) {
+        if (cols ? slm_get_col(matrix, idx[x]) : slm_get_row(matrix, idx[x])) {
+            order[count++] = idx[x];
+        }
+    }
+
+    // A bitset sorts and drops repeats in one go, unless the numbers are too scattered for one
+    const size_t words = ((cols ? slm_col_span(matrix) : slm_row_span(matrix)) + 63) / 64;
+    if (words > 4 * count) {
+        qsort(order, count, sizeof(size_t), slm_index_compare);
+        size_t unique = 0;
+        for (size_t x = 0; x < count; x++) {
+            if (!unique || (order[x] != order[unique - 1])) {
+                order[unique++] = order[x];
+            }
+        }
+        return unique;
+    }
+    uint64_t *bits = xcalloc(words ? words : 1, sizeof(uint64_t));
+    for (size_t x = 0; x < count; x++) {
+        bits[order[x] / 64] |= (uint64_t)1 << (order[x] % 64);
+    }
+    count = 0;
+    for (size_t w = 0; w < words; w++) {
+        for (uint64_t word = bits[w]; word; word &= word - 1) {
+            order[count++] = 64 * w + (size_t)__builtin_ctzll(word);
+        }
+    }
+    xfree(bits);
+    return count;
+}
+
+void slm_matrix_remove_rows(slm_matrix_t *matrix, const size_t *idx, size_t k)
+{
+    slm_matrix_settle(matrix);
+    // Visit the rows in ascending order, which is also the order their elements were laid out in by
+    // the bulk constructors, rather than the order of `idx`
+    size_t *order = xmalloc((k ? k : 1) * sizeof(size_t));
+    const size_t count = slm_index_order(matrix, false, idx, k, order);
+    for (size_t x = 0; x < count; x++) {
+        slm_matrix_remove_vec(matrix, slm_get_row(matrix, order[x]), true);
+    }
+    xfree(order);
+}
+
+void slm_matrix_remove_cols(slm_matrix_t *matrix, const size_t *idx, size_t k)
+{
+    slm_matrix_settle(matrix);
+    size_t *order = xmalloc((k ? k : 1) * sizeof(size_t));
+    const size_t count = slm_index_order(matrix, true, idx, k, order);
+    for (size_t x = 0; x < count; x++) {
+        slm_matrix_remove_vec(matrix, slm_get_col(matrix, order[x]), false);
+    }
+    xfree(order);
+}
+
+void slm_matrix_shrink(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    slm_dir_fit(&matrix->rows, &matrix->rows_size, &matrix->rows_sparse, matrix->first_row, slm_row_span(matrix), matrix->m);
+    slm_dir_fit(&matrix->cols, &matrix->cols_size, &matrix->cols_sparse, matrix->first_col, slm_col_span(matrix), matrix->n);
+}
+
+static slm_elem_t *slm_row_find(slm_vec_t *row, size_t n)
+{
+    if (row->dense) {
+        const slm_link_t link = slm_dense_get(row->dense, n);
+        return slm_elem_at(row->arena, link);
+    }
+    slm_elem_t *cell = slm_elem_at(row->arena, row->first);
+    for (; cell && cell->j < n; cell = slm_elem_at(row->arena, cell->next_col));
+    return (cell && cell->j == n) ? cell : NULL;
+}
+
+void slm_matrix_index(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    if (matrix->hash) {
+        return;
+    }
+    const size_t count = slm_total_elements(matrix);
+    size_t size = 16;
+    while (4 * count >= 3 * size) {
+        size *= 2;
+    }
+    matrix->hash = slm_hash_new(size);
+    for_each_row_in_matrix(row, matrix) {
+        for (slm_link_t link = row->first; link; link = slm_elem_at(matrix->arena, link)->next_col) {
+            slm_hash_put(matrix->hash, row->index, slm_elem_at(matrix->arena, link)->j, link);
+        }
+    }
+}
+
+void slm_matrix_unindex(slm_matrix_t *matrix)
+{
+    slm_hash_free(matrix->hash);
+    matrix->hash = NULL;
+}
+
+void slm_matrix_track_components(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    if (matrix->components) {
+        return;
+    }
+    slm_components_t *components = slm_components_new();
+    const size_t rows = slm_row_span(matrix);
+    const size_t cols = slm_col_span(matrix);
+    const size_t size = rows > cols ? rows : cols;
+    if (size) {
+        slm_components_reserve(components, 2 * size - 1);
+    }
+    for_each_row_in_matrix(row, matrix) {
+        for_each_element_in_row(elem, row) {
+            slm_components_link(components, elem->i, elem->j);
+        }
+    }
+    matrix->components = components;
+}
+
+void slm_matrix_untrack_components(slm_matrix_t *matrix)
+{
+    slm_components_free(matrix->components);
+    matrix->components = NULL;
+}
+
+size_t slm_matrix_component_count(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    if (matrix->components) {
+        if (matrix->components->stale_count) {
+            slm_components_settle(matrix->components, matrix);
+        }
+        return matrix->components->count;
+    }
+    slm_blocks_t *labels = slm_matrix_blocks(matrix);
+    const size_t count = labels->count;
+    slm_blocks_free(labels);
+    return count;
+}
+
+void slm_matrix_transpose_inplace(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    // Each element trades its indices and its pairs of links, turning every row list into a column list
+    // Bitset indices stay valid, as they are keyed by the index along their own vector
+    for_each_row_in_matrix(row, matrix) {
+        for (slm_link_t link = row->first, next = SLM_NIL; link; link = next) {
+            slm_elem_t *elem = slm_elem_at(matrix->arena, link);
+            next = elem->next_col;
+            *elem = (slm_elem_t) {
+                .i = elem->j,
+                .j = elem->i,
+                .next_row = elem->next_col,
+                .prev_row = elem->prev_col,
+                .next_col = elem->next_row,
+                .prev_col = elem->prev_row
+            };
+        }
+    }
+    *matrix = (slm_matrix_t) {
+        .first_row = matrix->first_col,
+        .last_row = matrix->last_col,
+        .first_col = matrix->first_row,
+        .last_col = matrix->last_row,
+        .rows = matrix->cols,
+        .cols = matrix->rows,
+        .rows_size = matrix->cols_size,
+        .cols_size = matrix->rows_size,
+        .rows_sparse = matrix->cols_sparse,
+        .cols_sparse = matrix->rows_sparse,
+        .m = matrix->n,
+        .n = matrix->m,
+        .arena = matrix->arena,
+        .hash = matrix->hash,
+        .components = matrix->components,
+        .versions = matrix->versions,
+        .deferred = matrix->deferred
+    };
+    slm_versions_invalidate(matrix);
+
+    // Rehash every element within the same slots, which hold the same number of points as before
+    if (matrix->hash) {
+        memset(matrix->hash->slots, 0, matrix->hash->size * sizeof(slm_hash_slot_t));
+        matrix->hash->count = 0;
+        for_each_row_in_matrix(row, matrix) {
+            for (slm_link_t link = row->first; link; link = slm_elem_at(matrix->arena, link)->next_col) {
+                slm_hash_put(matrix->hash, row->index, slm_elem_at(matrix->arena, link)->j, link);
+            }
+        }
+    }
+
+    // Row `m` becomes column `m`, i.e., node `2m` becomes node `2m + 1` and vice versa
+    slm_components_t *components = matrix->components;
+    if (components) {
+        for (size_t x = 0; x < components->size; x += 2) {
+            const size_t parent = components->parent[x];
+            components->parent[x] = components->parent[x + 1] ^ 1;
+            components->parent[x + 1] = parent ^ 1;
+            const size_t next = components->next[x];
+            components->next[x] = (components->next[x + 1] == SIZE_MAX) ? SIZE_MAX : components->next[x + 1] ^ 1;
+            components->next[x + 1] = (next == SIZE_MAX) ? SIZE_MAX : next ^ 1;
+        }
+        for (size_t s = 0; s < components->stale_count; s++) {
+            components->stale[s] ^= 1;
+        }
+    }
+}
+
+slm_elem_t *slm_matrix_find(const slm_matrix_t *matrix, size_t m, size_t n)
+{
+    slm_matrix_settle(matrix);
+    if (matrix->hash) {
+        const slm_link_t link = slm_hash_slot(matrix->hash, m, n)->link;
+        return slm_elem_at(matrix->arena, link);
+    }
+
+    // Without an index, search whichever of the row and column is quicker to search
+    slm_vec_t *row = slm_get_row(matrix, m);
+    slm_vec_t *col = slm_get_col(matrix, n);
+    if (!row || !col) {
+        return NULL;
+    }
+    if (row->dense || (!col->dense && (row->length <= col->length))) {
+        return slm_row_find(row, n);
+    }
+    if (col->dense) {
+        const slm_link_t link = slm_dense_get(col->dense, m);
+        return slm_elem_at(matrix->arena, link);
+    }
+    for_each_element_in_col(elem, col) {
+        if (elem->i >= m) {
+            return (elem->i == m) ? elem : NULL;
+        }
+    }
+    return NULL;
+}
+
+bool slm_matrix_contains(const slm_matrix_t *matrix, size_t m, size_t n)
+{
+    return slm_matrix_find(matrix, m, n) != NULL;
+}
+
+// Number of probes whose slots are prefetched ahead of the probe in progress
+#define SLM_PROBE_AHEAD 8
+
+size_t slm_matrix_contains_batch(const slm_matrix_t *matrix, const size_t *i, const size_t *j, bool *found, size_t count)
+{
+    slm_matrix_settle(matrix);
+    size_t present = 0;
+    const slm_hash_t *hash = matrix->hash;
+    if (!hash) {
+        for (size_t k = 0; k < count; k++) {
+            found[k] = slm_matrix_contains(matrix, i[k], j[k]);
+            present += found[k];
+        }
+        return present;
+    }
+
+    // Every probe is an independent cache miss, so overlap them by requesting
+    // the home slots of later probes while earlier ones complete
+    const size_t mask = hash->size - 1;
+    for (size_t k = 0; k < count && k < SLM_PROBE_AHEAD; k++) {
+        __builtin_prefetch(&hash->slots[slm_hash_point(i[k], j[k]) & mask]);
+    }
+    for (size_t k = 0; k < count; k++) {
+        if (k + SLM_PROBE_AHEAD < count) {
+            const size_t ahead = k + SLM_PROBE_AHEAD;
+            __builtin_prefetch(&hash->slots[slm_hash_point(i[ahead], j[ahead]) & mask]);
+        }
+        found[k] = slm_hash_slot(hash, i[k], j[k])->link != SLM_NIL;
+        present += found[k];
+    }
+    return present;
+}
+
+void slm_matrix_print(FILE *f, const slm_matrix_t *matrix)
+{
+    slm_matrix_write(f, matrix, SLM_FORMAT_DENSE, 1);
+}
+
+size_t slm_total_elements(const slm_matrix_t *matrix)
+{
+    size_t count = 0;
+    for_each_row_in_matrix(row, matrix) {
+        count += row->length;
+    }
+    return count;
+}
+
+slm_visited_t *slm_visited_new(void)
+{
+    return xcalloc(1, sizeof(slm_visited_t));
+}
+
+void slm_visited_free(slm_visited_t *visited)
+{
+    if (visited) {
+        xfree(visited->rows);
+        xfree(visited->cols);
+        xfree(visited->row_keys);
+        xfree(visited->col_keys);
+        xfree(visited);
+    }
+}
+
+// Return whether number `k` is marked in the bitset `bits` of `size` bits, or, if `keys`, in the
+// hash table of `size` slots whose taken slots `bits` flags and `keys` numbers
+static inline bool slm_visited_has(const uint64_t *bits, const size_t *keys, size_t size, size_t k)
+{
+    if (unlikely(keys != NULL)) {
+        const size_t mask = size - 1;
+        for (size_t s = slm_hash_point(k, 0) & mask; bits[s / 64] >> (s % 64) & 1; s = (s + 1) & mask) {
+            if (keys[s] == k) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return k < size && (bits[k / 64] >> (k % 64) & 1);
+}
+
+// Mark number `k`, which must be covered, in the bitset or hash table of `slm_visited_has`, returning whether it was already marked
+static inline bool slm_visited_mark(uint64_t *bits, size_t *keys, size_t size, size_t k)
+{
+    size_t s = k;
+    if (unlikely(keys != NULL)) {
+        const size_t mask = size - 1;
+        for (s = slm_hash_point(k, 0) & mask; bits[s / 64] >> (s % 64) & 1; s = (s + 1) & mask) {
+            if (keys[s] == k) {
+                return true;
+            }
+        }
+        keys[s] = k;
+    }
+    const uint64_t bit = (uint64_t)1 << (s % 64);
+    const bool set = bits[s / 64] & bit;
+    bits[s / 64] |= bit;
+    return set;
+}
+
+bool slm_visited_row(const slm_visited_t *visited, size_t m)
+{
+    return slm_visited_has(visited->rows, visited->row_keys, visited->m, m);
+}
+
+bool slm_visited_col(const slm_visited_t *visited, size_t n)
+{
+    return slm_visited_has(visited->cols, visited->col_keys, visited->n, n);
+}
+
+// Clear the bitset `*bits` of `*words` words allocated, and the hash table `*keys`, to cover `count` numbers below `span`:
+// by number, or if `sparse`, through a table of as many slots as a sparse directory of them. Returns the bits or slots covered
+static size_t slm_visited_cover(uint64_t **bits, size_t *words, size_t **keys, size_t span, size_t count, bool sparse)
+{
+    const size_t size = sparse ? slm_dir_table_size(count) : span;
+    const size_t used = (size + 63) / 64;
+    if (used > *words) {
+        *bits = xrealloc(*bits, used * sizeof(uint64_t));
+        *words = used;
+    }
+    if (used) {
+        memset(*bits, 0, used * sizeof(uint64_t));
+    }
+    xfree(*keys);
+    *keys = sparse ? xmalloc(size * sizeof(size_t)) : NULL;
+    return size;
+}
+
+// Clear `visited`, covering every row and column of `matrix`
+static void slm_visited_reset(slm_visited_t *visited, const slm_matrix_t *matrix)
+{
+    visited->m = slm_visited_cover(&visited->rows, &visited->rows_size, &visited->row_keys, slm_row_span(matrix), matrix->m, matrix->rows_sparse);
+    visited->n = slm_visited_cover(&visited->cols, &visited->cols_size, &visited->col_keys, slm_col_span(matrix), matrix->n, matrix->cols_sparse);
+}
+
+static pthread_key_t slm_visited_key;
+static pthread_once_t slm_visited_once = PTHREAD_ONCE_INIT;
+
+static void slm_visited_destroy(void *visited)
+{
+    slm_visited_free(visited);
+}
+
+static void slm_visited_key_create(void)
+{
+    if (pthread_key_create(&slm_visited_key, slm_visited_destroy)) {
+        abort();
+    }
+}
+
+// Return the visited set private to the calling thread, freed when the thread exits
+static slm_visited_t *slm_visited_local(void)
+{
+    pthread_once(&slm_visited_once, slm_visited_key_create);
+    slm_visited_t *visited = pthread_getspecific(slm_visited_key);
+    if (!visited) {
+        visited = slm_visited_new();
+        if (pthread_setspecific(slm_visited_key, visited)) {
+            abort();
+        }
+    }
+    return visited;
+}
+
+static bool slm_matrix_reachability(const slm_matrix_t *matrix, slm_visited_t *visited, slm_vec_t *row)
+{
+    size_t rows_visited = 0;
+    size_t cols_visited = 0;
+    bool out = false;
+
+    typedef struct stack_frame_t {
+        slm_vec_t *row;
+        slm_vec_t *col;
+        slm_elem_t *xm; // row-iterating element
+        slm_elem_t *xn; // column-iterating element
+        bool stat;
+        void *ret_addr;
+    } stack_frame_t;
+
+    ptrdiff_t stack_depth = 0;
+    ptrdiff_t frame_capacity = 4096;
+    ptrdiff_t depth_max = 0;
+    stack_frame_t *stk = xmalloc(frame_capacity * sizeof(stack_frame_t));
+    stk[stack_depth] = (stack_frame_t) {
+        .row = row,
+        .col = NULL,
+        .xm = NULL,
+        .xn = NULL,
+        .stat = false,
+        .ret_addr = &&ret_addr_0
+    };
+
+next_frame:
+    while (stack_depth >= 0) {
+        if (unlikely(stack_depth + 2 >= frame_capacity)) {
+            frame_capacity *= 2;
+            stk = xrealloc(stk, frame_capacity * sizeof(stack_frame_t));
+        }
+        depth_max = (stack_depth >= depth_max) ? stack_depth + 1 : depth_max;
+        stack_frame_t stk_top = stk[stack_depth--];
+        row = stk_top.row;
+        slm_vec_t *col = stk_top.col;
+        slm_elem_t *xm = stk_top.xm;
+        slm_elem_t *xn = stk_top.xn;
+        bool stat = stk_top.stat;
+        slm_vec_t *node = NULL;
+        goto *stk_top.ret_addr;
+
+ret_addr_0:
+        if (!slm_visited_mark(visited->rows, visited->row_keys, visited->m, row->index)) {
+            if (++rows_visited == matrix->m) {
+                out = true;
+                goto next_frame;
+            }
+            for_each_stack_element_in_row (xm, row) {
+                col = slm_get_col(matrix, xm->j);
+                if (!slm_visited_mark(visited->cols, visited->col_keys, visited->n, col->index)) {
+                    stat = false;
+                    if (++cols_visited == matrix->n) {
+                        stat = true;
+                        goto next_col;
+                    }
+                    for_each_stack_element_in_col (xn, col) {
+                        node = slm_get_row(matrix, xn->i);
+                        if (!slm_visited_row(visited, node->index)) {
+                            stk[++stack_depth] = (stack_frame_t) {
+                                .row = row,
+                                .col = col,
+                                .xm = xm,
+                                .xn = xn,
+                                .stat = stat,
+                                .ret_addr = &&ret_addr_1
+                            };
+                            stk[++stack_depth] = (stack_frame_t) {
+                                .row = node,
+                                .col = NULL,
+                                .xm = NULL,
+                                .xn = NULL,
+                                .stat = false,
+                                .ret_addr = &&ret_addr_0
+                            };
+                            goto next_frame;
+ret_addr_1:
+                            if (out) {
+                                stat = true;
+                                goto next_col;
+                            }
+                        }
+                    }
+                    next_col:
+                    if (stat) {
+                        out = true;
+                        goto next_frame;
+                    }
+                }
+            }
+        }
+        out = false;
+        goto next_frame;
+    }
+
+    free(stk);
+    slm_stat_max(dfs_depth_max, depth_max);
+    return out;
+}
+
+static slm_blocks_t *slm_blocks_new(size_t count, size_t m, size_t n)
+{
+    slm_blocks_t *blocks = xmalloc(sizeof(slm_blocks_t) + (m + n) * sizeof(size_t));
+    *blocks = (slm_blocks_t) {
+        .count = count,
+        .m = m,
+        .n = n,
+        .row_block = (size_t *)(blocks + 1),
+        .col_block = (size_t *)(blocks + 1) + m
+    };
+    return blocks;
+}
+
+// Whether the tracked components of `matrix` are current, and so may answer queries on their own
+static inline bool slm_components_settled(const slm_matrix_t *matrix)
+{
+    return matrix->components && !matrix->components->stale_count;
+}
+
+// Label the rows and columns of `matrix` from its settled components, numbering blocks in order of their first row
+static slm_blocks_t *slm_components_label(const slm_matrix_t *matrix)
+{
+    const slm_components_t *components = matrix->components;
+    slm_blocks_t *labels = slm_blocks_new(0, matrix->m, matrix->n);
+    size_t *block = xcalloc(components->size, sizeof(size_t)); // block + 1 of each root
+    size_t r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        const size_t root = slm_components_root(components, 2 * row->index);
+        if (!block[root]) {
+            block[root] = ++labels->count;
+        }
+        labels->row_block[r++] = block[root] - 1;
+    }
+    size_t c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        labels->col_block[c++] = block[slm_components_root(components, 2 * col->index + 1)] - 1;
+    }
+    xfree(block);
+    return labels;
+}
+
+// Fold every block but block 0, which holds the first row, into a single remainder
+static void slm_blocks_fold(slm_blocks_t *labels)
+{
+    for (size_t r = 0; r < labels->m; r++) {
+        labels->row_block[r] = !!labels->row_block[r];
+    }
+    for (size_t c = 0; c < labels->n; c++) {
+        labels->col_block[c] = !!labels->col_block[c];
+    }
+    labels->count = 2;
+}
+
+bool slm_matrix_connected(const slm_matrix_t *matrix, slm_visited_t *visited)
+{
+    slm_matrix_settle(matrix);
+    slm_visited_reset(visited, matrix);
+    return !matrix->m || slm_matrix_reachability(matrix, visited, matrix->first_row);
+}
+
+// Label the rows and columns marked in `visited` as block 0, and the rest as block 1
+static slm_blocks_t *slm_blocks_from_visited(const slm_matrix_t *matrix, const slm_visited_t *visited)
+{
+    slm_blocks_t *labels = slm_blocks_new(2, matrix->m, matrix->n);
+    size_t r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        labels->row_block[r++] = !slm_visited_row(visited, row->index);
+    }
+    size_t c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        labels->col_block[c++] = !slm_visited_col(visited, col->index);
+    }
+    return labels;
+}
+
+// Hand out the two blocks of `blk`, the one with fewer columns as `A`
+static void slm_partition_finish(slm_matrix_t **blk, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    *A = blk[0];
+    *B = blk[1];
+    xfree(blk);
+
+    if ((*A)->n > (*B)->n) {
+        slm_matrix_t *swap = *A;
+        *A = *B;
+        *B = swap;
+    }
+}
+
+static bool slm_partition_visited(const slm_matrix_t *matrix, slm_visited_t *visited, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    if (slm_matrix_connected(matrix, visited)) {
+        return false;
+    }
+
+    slm_blocks_t *labels = slm_blocks_from_visited(matrix, visited);
+    slm_matrix_t **blk;
+    slm_block_split(matrix, labels, &blk);
+    slm_blocks_free(labels);
+    slm_partition_finish(blk, A, B);
+    return true;
+}
+
+static bool slm_partition(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    // Settling would modify the tracked components, so stale ones are left to the next query that may
+    if (!slm_components_settled(matrix)) {
+        return slm_partition_visited(matrix, slm_visited_local(), A, B);
+    }
+    if (matrix->components->count < 2) {
+        return false;
+    }
+
+    slm_blocks_t *labels = slm_components_label(matrix);
+    slm_blocks_fold(labels);
+    slm_matrix_t **blk;
+    slm_block_split(matrix, labels, &blk);
+    slm_blocks_free(labels);
+    slm_partition_finish(blk, A, B);
+    return true;
+}
+
+static bool slm_partition_move(slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    slm_blocks_t *labels = NULL;
+    if (matrix->components) {
+        if (slm_matrix_component_count(matrix) < 2) {
+            return false;
+        }
+        labels = slm_components_label(matrix);
+        slm_blocks_fold(labels);
+    }
+    else {
+        slm_visited_t *visited = slm_visited_local();
+        if (slm_matrix_connected(matrix, visited)) {
+            return false;
+        }
+        labels = slm_blocks_from_visited(matrix, visited);
+    }
+    slm_matrix_t **blk;
+    slm_block_split_move(matrix, labels, &blk);
+    slm_blocks_free(labels);
+    slm_partition_finish(blk, A, B);
+    return true;
+}
+
+bool slm_diagonal_partition_visited(const slm_matrix_t *matrix, slm_visited_t *visited, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    slm_matrix_settle(matrix);
+    const uint64_t start = slm_stat_clock();
+    const bool split = slm_partition_visited(matrix, visited, A, B);
+    slm_stat_partition(start);
+    return split;
+}
+
+bool slm_diagonal_partition(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    slm_matrix_settle(matrix);
+    const uint64_t start = slm_stat_clock();
+    const bool split = slm_partition(matrix, A, B);
+    slm_stat_partition(start);
+    return split;
+}
+
+bool slm_diagonal_partition_move(slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+{
+    slm_matrix_settle(matrix);
+    const uint64_t start = slm_stat_clock();
+    const bool split = slm_partition_move(matrix, A, B);
+    slm_stat_partition(start);
+    return split;
+}
+
+// Allocate a snapshot and all of its arrays as a single block
+static slm_frozen_t *slm_frozen_new(size_t m, size_t n, size_t nnz)
+{
+    const size_t ptrs = m + n + 2;
+    const size_t indices = m + n + 2 * nnz;
+    slm_frozen_t *frozen = xmalloc(sizeof(slm_frozen_t) + ptrs * sizeof(size_t) + indices * sizeof(slm_index_t));
+    size_t *ptr = (size_t *)(frozen + 1);
+    slm_index_t *index = (slm_index_t *)(ptr + ptrs);
+    *frozen = (slm_frozen_t) {
+        .m = m,
+        .n = n,
+        .nnz = nnz,
+        .row_ptr = ptr,
+        .col_ptr = ptr + m + 1,
+        .row_index = index,
+        .col_index = index + m,
+        .row_elems = index + m + n,
+        .col_elems = index + m + n + nnz
+    };
+    return frozen;
+}
+
+void slm_frozen_free(slm_frozen_t *frozen)
+{
+    if (frozen && frozen->map && !frozen->base) {
+        munmap(frozen->map, frozen->map_size);
+    }
+    xfree(frozen);
+}
+
+// Position of `k` among the `count` ascending numbers of `index`, which must hold it
+static size_t slm_index_rank(const slm_index_t *index, size_t count, size_t k)
+{
+    size_t lo = 0;
+    while (count > 1) {
+        const size_t half = count / 2;
+        lo = index[lo + half] <= k ? lo + half : lo;
+        count -= half;
+    }
+    return lo;
+}
+
+slm_frozen_t *slm_matrix_freeze(const slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    slm_frozen_t *frozen = slm_frozen_new(matrix->m, matrix->n, slm_total_elements(matrix));
+
+    // Positions of each row and column, indexed by row / column number, unless a directory is a
+    // hash table, whose numbers are too scattered for that. Those are searched for instead
+    size_t *row_pos = matrix->rows_sparse ? NULL : xmalloc(slm_row_span(matrix) * sizeof(size_t));
+    size_t *col_pos = matrix->cols_sparse ? NULL : xmalloc(slm_col_span(matrix) * sizeof(size_t));
+
+    size_t r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        frozen->row_index[r] = row->index;
+        if (row_pos) {
+            row_pos[row->index] = r;
+        }
+        r++;
+    }
+    size_t c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        frozen->col_index[c] = col->index;
+        if (col_pos) {
+            col_pos[col->index] = c;
+        }
+        c++;
+    }
+
+    size_t k = 0;
+    r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        frozen->row_ptr[r++] = k;
+        for_each_element_in_row(elem, row) {
+            frozen->row_elems[k++] = col_pos ? col_pos[elem->j] : slm_index_rank(frozen->col_index, frozen->n, elem->j);
+        }
+    }
+    frozen->row_ptr[r] = k;
+
+    k = 0;
+    c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        frozen->col_ptr[c++] = k;
+        for_each_element_in_col(elem, col) {
+            frozen->col_elems[k++] = row_pos ? row_pos[elem->i] : slm_index_rank(frozen->row_index, frozen->m, elem->i);
+        }
+    }
+    frozen->col_ptr[c] = k;
+
+    xfree(col_pos);
+    xfree(row_pos);
+    return frozen;
+}
+
+slm_matrix_t *slm_matrix_thaw(const slm_frozen_t *frozen)
+{
+    slm_matrix_t *matrix = slm_matrix_new();
+    if (!frozen->nnz) {
+        return matrix;
+    }
+    slm_matrix_reserve(matrix, frozen->row_index[frozen->m - 1], frozen->col_index[frozen->n - 1], frozen->m, frozen->n);
+
+    // Every row, column, and element arrives in order, so each is appended at the tail
+    for (size_t c = 0; c < frozen->n; c++) {
+        slm_append_col(matrix, frozen->col_index[c]);
+    }
+    for (size_t r = 0; r < frozen->m; r++) {
+        slm_vec_t *row = slm_append_row(matrix, frozen->row_index[r]);
+        for (size_t k = frozen->row_ptr[r]; k < frozen->row_ptr[r + 1]; k++) {
+            slm_append_elem(matrix, row, slm_get_col(matrix, frozen->col_index[frozen->row_elems[k]]));
+        }
+    }
+    return matrix;
+}
+
+slm_frozen_t *slm_frozen_dupl(const slm_frozen_t *frozen)
+{
+    slm_frozen_t *dupl = slm_frozen_new(frozen->m, frozen->n, frozen->nnz);
+    memcpy(dupl->row_ptr, frozen->row_ptr, (frozen->m + 1) * sizeof(size_t));
+    memcpy(dupl->col_ptr, frozen->col_ptr, (frozen->n + 1) * sizeof(size_t));
+    memcpy(dupl->row_index, frozen->row_index, frozen->m * sizeof(slm_index_t));
+    memcpy(dupl->col_index, frozen->col_index, frozen->n * sizeof(slm_index_t));
+    memcpy(dupl->row_elems, frozen->row_elems, frozen->nnz * sizeof(slm_index_t));
+    memcpy(dupl->col_elems, frozen->col_elems, frozen->nnz * sizeof(slm_index_t));
+    return dupl;
+}
+
+slm_frozen_t *slm_frozen_transpose_view(const slm_frozen_t *frozen)
+{
+    // The compressed column form of `frozen` is the compressed row form of its transpose
+    slm_frozen_t *view = xmalloc(sizeof(slm_frozen_t));
+    *view = (slm_frozen_t) {
+        .m = frozen->n,
+        .n = frozen->m,
+        .nnz = frozen->nnz,
+        .row_ptr = frozen->col_ptr,
+        .col_ptr = frozen->row_ptr,
+        .row_index = frozen->col_index,
+        .col_index = frozen->row_index,
+        .row_elems = frozen->col_elems,
+        .col_elems = frozen->row_elems,
+        .base = frozen->base ? frozen->base : frozen
+    };
+    return view;
+}
+
+// Levels of row tree enough for any row number
+#define SLM_SNAP_LEVELS ((64 + SLM_SNAP_SHIFT - 1) / SLM_SNAP_SHIFT)
+
+// Slot leading to row `m` within a node `level` levels above the rows
+static inline size_t slm_snap_slot(size_t m, size_t level)
+{
+    return (m >> (SLM_SNAP_SHIFT * level)) & ((1 << SLM_SNAP_SHIFT) - 1);
+}
+
+static const slm_snap_row_t *slm_snap_find(const slm_snapshot_t *snapshot, size_t m)
+{
+    if ((snapshot->height < SLM_SNAP_LEVELS) && (m >> (SLM_SNAP_SHIFT * snapshot->height))) {
+        return NULL;
+    }
+    const slm_snap_node_t *node = snapshot->root;
+    for (size_t level = snapshot->height; node && (--level > 0);) {
+        node = node->slots[slm_snap_slot(m, level)];
+    }
+    return node ? node->slots[slm_snap_slot(m, 0)] : NULL;
+}
+
+// Leave `ptr`, reached by version `snapshot` but not by its successor, for `snapshot` to free
+static void slm_snapshot_retire(slm_snapshot_t *snapshot, void *ptr)
+{
+    if (snapshot->retired_count == snapshot->retired_size) {
+        snapshot->retired_size = snapshot->retired_size ? 2 * snapshot->retired_size : 64;
+        snapshot->retired = xrealloc(snapshot->retired, snapshot->retired_size * sizeof(void *));
+    }
+    snapshot->retired[snapshot->retired_count++] = ptr;
+}
+
+// Retire every node and row of the tree `node`, `level` levels above the rows, to `snapshot`
+static void slm_snap_tree_retire(slm_snapshot_t *snapshot, slm_snap_node_t *node, size_t level)
+{
+    for (size_t k = 0; node && (k < (1 << SLM_SNAP_SHIFT)); k++) {
+        if (level) {
+            slm_snap_tree_retire(snapshot, node->slots[k], level - 1);
+        }
+        else if (node->slots[k]) {
+            slm_snapshot_retire(snapshot, node->slots[k]);
+        }
+    }
+    if (node) {
+        slm_snapshot_retire(snapshot, node);
+    }
+}
+
+// Store `row`, or no row if NULL, as row `m` of the tree `*node`, `level` levels above the rows, on behalf of
+// version `next`. Nodes built by an older version are copied first, leaving the originals to `prev`
+static void slm_snap_put(slm_snapshot_t *prev, slm_snapshot_t *next, slm_snap_node_t **node, size_t level, size_t m, slm_snap_row_t *row)
+{
+    slm_snap_node_t *own = *node;
+    if (!own || (own->version != next->version)) {
+        own = xcalloc(1, sizeof(slm_snap_node_t));
+        if (*node) {
+            *own = **node;
+            slm_snapshot_retire(prev, *node);
+        }
+        own->version = next->version;
+        *node = own;
+    }
+
+    void **slot = &own->slots[slm_snap_slot(m, level)];
+    const bool had = *slot;
+    if (level) {
+        slm_snap_put(prev, next, (slm_snap_node_t **)slot, level - 1, m, row);
+    }
+    else {
+        slm_snap_row_t *old = *slot;
+        if (old) {
+            next->m--;
+            next->nnz -= old->length;
+            slm_snapshot_retire(prev, old);
+        }
+        if (row) {
+            next->m++;
+            next->nnz += row->length;
+        }
+        *slot = row;
+    }
+    own->count += (size_t)(*slot != NULL) - (size_t)had;
+
+    // A node of `next` left empty was never published, so goes at once
+    if (!own->count) {
+        xfree(own);
+        *node = NULL;
+    }
+}
+
+// Store `row` as row `m` of version `next`, growing its tree as needed
+static void slm_snapshot_put(slm_snapshot_t *prev, slm_snapshot_t *next, size_t m, slm_snap_row_t *row)
+{
+    while (!next->height || ((next->height < SLM_SNAP_LEVELS) && (m >> (SLM_SNAP_SHIFT * next->height)))) {
+        if (next->root) {
+            slm_snap_node_t *root = xcalloc(1, sizeof(slm_snap_node_t));
+            root->version = next->version;
+            root->count = 1;
+            root->slots[0] = next->root;
+            next->root = root;
+        }
+        next->height++;
+    }
+    slm_snap_put(prev, next, &next->root, next->height - 1, m, row);
+}
+
+static slm_snap_row_t *slm_snap_row_new(const slm_vec_t *row)
+{
+    slm_snap_row_t *snap = xmalloc(sizeof(slm_snap_row_t) + row->length * sizeof(slm_index_t));
+    snap->index = row->index;
+    snap->length = row->length;
+    size_t k = 0;
+    for_each_element_in_row(elem, row) {
+        snap->cols[k++] = elem->j;
+    }
+    return snap;
+}
+
+slm_snapshot_t *slm_matrix_snapshot(slm_matrix_t *matrix)
+{
+    slm_matrix_settle(matrix);
+    slm_versions_t *versions = matrix->versions;
+    if (!versions) {
+        versions = xcalloc(1, sizeof(slm_versions_t));
+        versions->newest = xcalloc(1, sizeof(slm_snapshot_t));
+        versions->newest->refs = 1;
+        versions->oldest = versions->newest;
+        versions->stale = true;
+        matrix->versions = versions;
+    }
+
+    // Build the next version from the newest by replacing each changed row, and the path to it
+    slm_snapshot_t *prev = versions->newest;
+    if (versions->stale || versions->dirty_count) {
+        slm_snapshot_t *next = xmalloc(sizeof(slm_snapshot_t));
+        *next = (slm_snapshot_t) {
+            .version = prev->version + 1,
+            .m = prev->m,
+            .nnz = prev->nnz,
+            .height = prev->height,
+            .root = prev->root,
+            .refs = 1
+        };
+        if (versions->stale) {
+            slm_snap_tree_retire(prev, prev->root, prev->height - 1);
+            next->root = NULL;
+            next->m = 0;
+            next->nnz = 0;
+            for_each_row_in_matrix(row, matrix) {
+                slm_snapshot_put(prev, next, row->index, slm_snap_row_new(row));
+            }
+        }
+        else {
+            size_t *dirty = versions->dirty;
+            qsort(dirty, versions->dirty_count, sizeof(size_t), slm_index_compare);
+            for (size_t k = 0; k < versions->dirty_count; k++) {
+                if (k && (dirty[k] == dirty[k - 1])) {
+                    continue;
+                }
+                const slm_vec_t *row = slm_get_row(matrix, dirty[k]);
+                if (row) {
+                    slm_snapshot_put(prev, next, dirty[k], slm_snap_row_new(row));
+                }
+                else if (slm_snap_find(next, dirty[k])) {
+                    slm_snapshot_put(prev, next, dirty[k], NULL);
+                }
+            }
+        }
+        versions->dirty_count = 0;
+        versions->stale = false;
+
+        prev->newer = next;
+        versions->newest = next;
+        __atomic_sub_fetch(&prev->refs, 1, __ATOMIC_RELEASE);
+        prev = next;
+    }
+
+    slm_versions_reclaim(versions);
+    __atomic_add_fetch(&prev->refs, 1, __ATOMIC_RELAXED);
+    return prev;
+}
+
+void slm_snapshot_release(slm_snapshot_t *snapshot)
+{
+    __atomic_sub_fetch(&snapshot->refs, 1, __ATOMIC_RELEASE);
+}
+
+const slm_index_t *slm_snapshot_row(const slm_snapshot_t *snapshot, size_t m, size_t *length)
+{
+    const slm_snap_row_t *row = slm_snap_find(snapshot, m);
+    *length = row ? row->length : 0;
+    return row ? row->cols : NULL;
+}
+
+bool slm_snapshot_contains(const slm_snapshot_t *snapshot, size_t m, size_t n)
+{
+    const slm_snap_row_t *row = slm_snap_find(snapshot, m);
+    return row && row->length && (row->cols[slm_index_rank(row->cols, row->length, n)] == n);
+}
+
+size_t slm_snapshot_total_elements(const slm_snapshot_t *snapshot)
+{
+    return snapshot->nnz;
+}
+
+// Store the rows of the tree `node`, `level` levels above the rows, to `rows` in ascending order, returning how many
+static size_t slm_snap_gather(const slm_snap_node_t *node, size_t level, const slm_snap_row_t **rows)
+{
+    size_t count = 0;
+    for (size_t k = 0; node && (k < (1 << SLM_SNAP_SHIFT)); k++) {
+        if (level) {
+            count += slm_snap_gather(node->slots[k], level - 1, rows + count);
+        }
+        else if (node->slots[k]) {
+            rows[count++] = node->slots[k];
+        }
+    }
+    return count;
+}
+
+slm_frozen_t *slm_snapshot_freeze(const slm_snapshot_t *snapshot)
+{
+    const slm_snap_row_t **rows = xmalloc((snapshot->m ? snapshot->m : 1) * sizeof(slm_snap_row_t *));
+    if (snapshot->root) {
+        slm_snap_gather(snapshot->root, snapshot->height - 1, rows);
+    }
+
+    // Column numbers in use, ascending and each once
+    size_t *cols = xmalloc((snapshot->nnz ? snapshot->nnz : 1) * sizeof(size_t));
+    size_t n = 0;
+    for (size_t r = 0; r < snapshot->m; r++) {
+        for (size_t k = 0; k < rows[r]->length; k++) {
+            cols[n++] = rows[r]->cols[k];
+        }
+    }
+    qsort(cols, n, sizeof(size_t), slm_index_compare);
+    size_t distinct = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (!distinct || (cols[k] != cols[distinct - 1])) {
+            cols[distinct++] = cols[k];
+        }
+    }
+
+    slm_frozen_t *frozen = slm_frozen_new(snapshot->m, distinct, snapshot->nnz);
+    for (size_t c = 0; c < distinct; c++) {
+        frozen->col_index[c] = cols[c];
+        frozen->col_ptr[c + 1] = 0;
+    }
+    frozen->col_ptr[0] = 0;
+
+    // Compressed rows first, counting the elements of each column on the way
+    size_t k = 0;
+    for (size_t r = 0; r < snapshot->m; r++) {
+        frozen->row_index[r] = rows[r]->index;
+        frozen->row_ptr[r] = k;
+        for (size_t e = 0; e < rows[r]->length; e++) {
+            const size_t c = slm_index_rank(frozen->col_index, distinct, rows[r]->cols[e]);
+            frozen->row_elems[k++] = c;
+            frozen->col_ptr[c + 1]++;
+        }
+    }
+    frozen->row_ptr[snapshot->m] = k;
+
+    // Then compressed columns, filled in row order so that each stays ascending
+    for (size_t c = 0; c < distinct; c++) {
+        frozen->col_ptr[c + 1] += frozen->col_ptr[c];
+        cols[c] = frozen->col_ptr[c];
+    }
+    for (size_t r = 0; r < snapshot->m; r++) {
+        for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+            frozen->col_elems[cols[frozen->row_elems[e]]++] = r;
+        }
+    }
+
+    xfree(cols);
+    xfree(rows);
+    return frozen;
+}
+
+// Binary snapshot files hold this header, padded to 64 bytes, followed by the
+// arrays of the snapshot in the order they are declared, each in native byte
+// order: `row_ptr` and `col_ptr` as 64-bit integers, the rest as integers of
+// `index_size` bytes. Every array is thus naturally aligned within the file
+#define SLM_FILE_MAGIC "SLMB"
+#define SLM_FILE_VERSION 1
+#define SLM_FILE_ORDER 0x01020304u
+#define SLM_FILE_HEADER 64
+
+typedef struct slm_file_header_t {
+    char magic[4];
+    uint32_t version;
+    uint32_t order; // `SLM_FILE_ORDER` as written, to detect foreign byte order
+    uint32_t index_size; // `sizeof(slm_index_t)` of the writer
+    uint64_t m;
+    uint64_t n;
+    uint64_t nnz;
+} slm_file_header_t;
+
+bool slm_frozen_save(const slm_frozen_t *frozen, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+
+    char header[SLM_FILE_HEADER] = { 0 };
+    const slm_file_header_t info = {
+        .magic = SLM_FILE_MAGIC,
+        .version = SLM_FILE_VERSION,
+        .order = SLM_FILE_ORDER,
+        .index_size = sizeof(slm_index_t),
+        .m = frozen->m,
+        .n = frozen->n,
+        .nnz = frozen->nnz
+    };
+    memcpy(header, &info, sizeof(info));
+
+    bool ok = fwrite(header, sizeof(header), 1, f) == 1;
+    ok = ok && (fwrite(frozen->row_ptr, sizeof(size_t), frozen->m + 1, f) == frozen->m + 1);
+    ok = ok && (fwrite(frozen->col_ptr, sizeof(size_t), frozen->n + 1, f) == frozen->n + 1);
+    ok = ok && (fwrite(frozen->row_index, sizeof(slm_index_t), frozen->m, f) == frozen->m);
+    ok = ok && (fwrite(frozen->col_index, sizeof(slm_index_t), frozen->n, f) == frozen->n);
+    ok = ok && (fwrite(frozen->row_elems, sizeof(slm_index_t), frozen->nnz, f) == frozen->nnz);
+    ok = ok && (fwrite(frozen->col_elems, sizeof(slm_index_t), frozen->nnz, f) == frozen->nnz);
+    return (fclose(f) == 0) && ok;
+}
+
+bool slm_matrix_save(const slm_matrix_t *matrix, const char *path)
+{
+    slm_frozen_t *frozen = slm_matrix_freeze(matrix);
+    const bool ok = slm_frozen_save(frozen, path);
+    slm_frozen_free(frozen);
+    return ok;
+}
+
+// Copy index array `src`, of `count` integers `size` bytes wide, into `dst`
+// Returns false if an index does not fit in `slm_index_t`
+static bool slm_index_convert(slm_index_t *dst, const void *src, size_t size, size_t count)
+{
+    for (size_t k = 0; k < count; k++) {
+        uint64_t v;
+        if (size == sizeof(uint32_t)) {
+            v = ((const uint32_t *)src)[k];
+        }
+        else {
+            v = ((const uint64_t *)src)[k];
+        }
+        if (v > SLM_INDEX_MAX) {
+            return false;
+        }
+        dst[k] = (slm_index_t)v;
+    }
+    return true;
+}
+
+// Map the file `path` read-only, storing its length to `size`. An empty file maps to NULL
+// Returns false on failure
+static bool slm_map_file(const char *path, void **map, size_t *size)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return false;
+    }
+    *size = (size_t)st.st_size;
+    *map = *size ? mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    return *map != MAP_FAILED;
+}
+
+slm_frozen_t *slm_matrix_map(const char *path)
+{
+    void *map;
+    size_t size;
+    if (!slm_map_file(path, &map, &size)) {
+        return NULL;
+    }
+    if (size < SLM_FILE_HEADER) {
+        if (map) {
+            munmap(map, size);
+        }
+        return NULL;
+    }
+
+    slm_file_header_t info;
+    memcpy(&info, map, sizeof(info));
+    const size_t isize = info.index_size;
+    const bool valid = !memcmp(info.magic, SLM_FILE_MAGIC, sizeof(info.magic)) &&
+                       (info.version == SLM_FILE_VERSION) && (info.order == SLM_FILE_ORDER) &&
+                       ((isize == sizeof(uint32_t)) || (isize == sizeof(uint64_t))) && (sizeof(size_t) == sizeof(uint64_t)) &&
+                       (info.m < size) && (info.n < size) && (info.nnz < size) &&
+                       (size == SLM_FILE_HEADER + (info.m + info.n + 2) * sizeof(uint64_t) + (info.m + info.n + 2 * info.nnz) * isize);
+    if (!valid) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    const size_t m = info.m;
+    const size_t n = info.n;
+    const size_t nnz = info.nnz;
+    size_t *ptr = (size_t *)((char *)map + SLM_FILE_HEADER);
+    char *index = (char *)(ptr + m + n + 2);
+    if ((ptr[m] != nnz) || (ptr[m + 1 + n] != nnz)) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    if (isize == sizeof(slm_index_t)) {
+        // Serve the snapshot straight from the mapping
+        slm_frozen_t *frozen = xmalloc(sizeof(slm_frozen_t));
+        slm_index_t *idx = (slm_index_t *)index;
+        *frozen = (slm_frozen_t) {
+            .m = m,
+            .n = n,
+            .nnz = nnz,
+            .row_ptr = ptr,
+            .col_ptr = ptr + m + 1,
+            .row_index = idx,
+            .col_index = idx + m,
+            .row_elems = idx + m + n,
+            .col_elems = idx + m + n + nnz,
+            .map = map,
+            .map_size = size
+        };
+        return frozen;
+    }
+
+    // Written with the other index width, so widen or narrow every index into a snapshot of its own
+    slm_frozen_t *frozen = slm_frozen_new(m, n, nnz);
+    memcpy(frozen->row_ptr, ptr, (m + n + 2) * sizeof(size_t));
+    const bool ok = slm_index_convert(frozen->row_index, index, isize, m + n + 2 * nnz);
+    munmap(map, size);
+    if (!ok) {
+        xfree(frozen);
+        return NULL;
+    }
+    return frozen;
+}
+
+size_t slm_frozen_total_elements(const slm_frozen_t *frozen)
+{
+    return frozen->nnz;
+}
+
+void slm_frozen_print(FILE *f, const slm_frozen_t *frozen)
+{
+    if (!frozen->m || !frozen->n) {
+        return;
+    }
+
+    fprintf(f, "%zu rows by %zu cols\n", frozen->m, frozen->n);
+    char *line = xmalloc(frozen->n + 1);
+    line[frozen->n] = '\n';
+    for (size_t r = 0; r < frozen->m; r++) {
+        memset(line, '-', frozen->n);
+        for (size_t k = frozen->row_ptr[r]; k < frozen->row_ptr[r + 1]; k++) {
+            line[frozen->row_elems[k]] = '1';
+        }
+        fprintf(f, "%-7zu\t", (size_t)frozen->row_index[r]);
+        fwrite(line, 1, frozen->n + 1, f);
+    }
+    xfree(line);
+}
+
+// Copy the rows of `frozen` with `keep[r] == want`, along with every column they touch
+static slm_frozen_t *slm_frozen_select(const slm_frozen_t *frozen, const bool *keep, bool want)
+{
+    // Position of each kept row / column in the selection
+    size_t *row_map = xmalloc((frozen->m + frozen->n) * sizeof(size_t));
+    size_t *col_map = row_map + frozen->m;
+
+    size_t m = 0;
+    size_t nnz = 0;
+    for (size_t r = 0; r < frozen->m; r++) {
+        if (keep[r] == want) {
+            row_map[r] = m++;
+            nnz += frozen->row_ptr[r + 1] - frozen->row_ptr[r];
+        }
+    }
+    size_t n = 0;
+    for (size_t c = 0; c < frozen->n; c++) {
+        if (keep[frozen->col_elems[frozen->col_ptr[c]]] == want) {
+            col_map[c] = n++;
+        }
+    }
+
+    slm_frozen_t *sel = slm_frozen_new(m, n, nnz);
+    size_t k = 0;
+    for (size_t r = 0; r < frozen->m; r++) {
+        if (keep[r] == want) {
+            sel->row_index[row_map[r]] = frozen->row_index[r];
+            sel->row_ptr[row_map[r]] = k;
+            for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+                sel->row_elems[k++] = col_map[frozen->row_elems[e]];
+            }
+        }
+    }
+    sel->row_ptr[m] = k;
+
+    k = 0;
+    for (size_t c = 0; c < frozen->n; c++) {
+        if (keep[frozen->col_elems[frozen->col_ptr[c]]] == want) {
+            sel->col_index[col_map[c]] = frozen->col_index[c];
+            sel->col_ptr[col_map[c]] = k;
+            for (size_t e = frozen->col_ptr[c]; e < frozen->col_ptr[c + 1]; e++) {
+                sel->col_elems[k++] = row_map[frozen->col_elems[e]];
+            }
+        }
+    }
+    sel->col_ptr[n] = k;
+
+    xfree(row_map);
+    return sel;
+}
+
+bool slm_frozen_diagonal_partition(const slm_frozen_t *frozen, slm_frozen_t **restrict A, slm_frozen_t **restrict B)
+{
+    if (!frozen->m) {
+        return false;
+    }
+
+    // Breadth-first search from the first row, alternating between rows and columns
+    bool *row_seen = xcalloc(frozen->m + frozen->n, sizeof(bool));
+    bool *col_seen = row_seen + frozen->m;
+    size_t *queue = xmalloc(frozen->m * sizeof(size_t));
+    size_t head = 0;
+    size_t tail = 0;
+    queue[tail++] = 0;
+    row_seen[0] = true;
+    while (head < tail) {
+        const size_t r = queue[head++];
+        for (size_t k = frozen->row_ptr[r]; k < frozen->row_ptr[r + 1]; k++) {
+            const size_t c = frozen->row_elems[k];
+            if (col_seen[c]) {
+                continue;
+            }
+            col_seen[c] = true;
+            for (size_t e = frozen->col_ptr[c]; e < frozen->col_ptr[c + 1]; e++) {
+                const size_t node = frozen->col_elems[e];
+                if (!row_seen[node]) {
+                    row_seen[node] = true;
+                    queue[tail++] = node;
+                }
+            }
+        }
+    }
+    xfree(queue);
+
+    if (tail == frozen->m) {
+        xfree(row_seen);
+        return false;
+    }
+
+    *A = slm_frozen_select(frozen, row_seen, true);
+    *B = slm_frozen_select(frozen, row_seen, false);
+    xfree(row_seen);
+
+    if ((*A)->n > (*B)->n) {
+        slm_frozen_t *swap = *A;
+        *A = *B;
+        *B = swap;
+    }
+    return true;
+}
+
+// The union-find forest below is shared between threads without locks. Every
+// link points at a smaller position, so roots are only ever replaced through a
+// compare-and-swap, and path halving may race harmlessly since it can only
+// swap one ancestor for another
+static size_t slm_uf_find(size_t *parent, size_t x)
+{
+    size_t p;
+    while ((p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED)) != x) {
+        const size_t gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+        __atomic_store_n(&parent[x], gp, __ATOMIC_RELAXED);
+        x = gp;
+    }
+    return x;
+}
+
+// Merge the sets of `a` and `b`, keeping the smaller root so that every root is the first member of its set
+static void slm_uf_union(size_t *parent, size_t a, size_t b)
+{
+    for (;;) {
+        a = slm_uf_find(parent, a);
+        b = slm_uf_find(parent, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            const size_t swap = a;
+            a = b;
+            b = swap;
+        }
+        size_t root = a;
+        if (__atomic_compare_exchange_n(&parent[a], &root, b, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+// Share of a labeling pass handled by a single thread
+typedef struct slm_uf_task_t {
+    size_t *parent; // union-find forest over row positions, then column positions
+    size_t begin; // first row (or forest entry) position
+    size_t end; // one past the last row (or forest entry) position
+    slm_vec_t *const *rows; // rows of a matrix, by position
+    const size_t *col_pos; // column positions of a matrix, by `slm_col_slot`
+    const slm_matrix_t *matrix; // matrix, if not labeling a snapshot
+    const slm_frozen_t *frozen; // snapshot, if not labeling a matrix
+} slm_uf_task_t;
+
+static void *slm_uf_matrix_worker(void *arg)
+{
+    const slm_uf_task_t *task = arg;
+    for (size_t r = task->begin; r < task->end; r++) {
+        for_each_element_in_row(elem, task->rows[r]) {
+            slm_uf_union(task->parent, r, task->col_pos[slm_col_slot(task->matrix, elem->j)]);
+        }
+    }
+    return NULL;
+}
+
+static void *slm_uf_frozen_worker(void *arg)
+{
+    const slm_uf_task_t *task = arg;
+    const slm_frozen_t *frozen = task->frozen;
+    for (size_t r = task->begin; r < task->end; r++) {
+        for (size_t k = frozen->row_ptr[r]; k < frozen->row_ptr[r + 1]; k++) {
+            slm_uf_union(task->parent, r, frozen->m + frozen->row_elems[k]);
+        }
+    }
+    return NULL;
+}
+
+// Point every entry of the forest directly at its root
+static void *slm_uf_flatten_worker(void *arg)
+{
+    const slm_uf_task_t *task = arg;
+    for (size_t k = task->begin; k < task->end; k++) {
+        __atomic_store_n(&task->parent[k], slm_uf_find(task->parent, k), __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// Hand each task its range of `bounds`
+static void slm_uf_bound(slm_uf_task_t *tasks, size_t parts, const size_t *bounds)
+{
+    for (size_t t = 0; t < parts; t++) {
+        tasks[t].begin = bounds[t];
+        tasks[t].end = bounds[t + 1];
+    }
+}
+
+// Turn a union-find forest over `m` row positions followed by `n` column positions into block labels
+static slm_blocks_t *slm_blocks_label(slm_uf_task_t *tasks, size_t threads, size_t m, size_t n)
+{
+    size_t *parent = tasks[0].parent;
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t].begin = (m + n) / threads * t;
+        tasks[t].end = (t + 1 == threads) ? m + n : (m + n) / threads * (t + 1);
+    }
+    slm_run_tasks(slm_uf_flatten_worker, tasks, sizeof(slm_uf_task_t), threads);
+
+    slm_blocks_t *blocks = slm_blocks_new(0, m, n);
+
+    // Each set contains a row, so every root is the leading row of its block
+    for (size_t r = 0; r < m; r++) {
+        blocks->row_block[r] = (parent[r] == r) ? blocks->count++ : blocks->row_block[parent[r]];
+    }
+    for (size_t c = 0; c < n; c++) {
+        blocks->col_block[c] = blocks->row_block[parent[m + c]];
+    }
+    return blocks;
+}
+
+static slm_uf_task_t *slm_uf_tasks(size_t *threads, size_t m, size_t n)
+{
+    *threads = *threads ? *threads : 1;
+    *threads = (*threads > m) && m ? m : *threads;
+    size_t *parent = xmalloc((m + n) * sizeof(size_t));
+    for (size_t k = 0; k < m + n; k++) {
+        parent[k] = k;
+    }
+    slm_uf_task_t *tasks = xcalloc(*threads, sizeof(slm_uf_task_t));
+    for (size_t t = 0; t < *threads; t++) {
+        tasks[t].parent = parent;
+    }
+    return tasks;
+}
+
+slm_blocks_t *slm_matrix_blocks_parallel(const slm_matrix_t *matrix, size_t threads)
+{
+    slm_matrix_settle(matrix);
+    if (slm_components_settled(matrix)) {
+        return slm_components_label(matrix);
+    }
+    slm_uf_task_t *tasks = slm_uf_tasks(&threads, matrix->m, matrix->n);
+    slm_vec_t **rows = xmalloc(matrix->m * sizeof(slm_vec_t *));
+    size_t *prefix = xmalloc((matrix->m + 1 + slm_col_slots(matrix)) * sizeof(size_t));
+    size_t *col_pos = prefix + matrix->m + 1;
+
+    size_t r = 0;
+    prefix[0] = 0;
+    for_each_row_in_matrix(row, matrix) {
+        prefix[r + 1] = prefix[r] + row->length;
+        rows[r++] = row;
+    }
+    size_t c = matrix->m;
+    for_each_col_in_matrix(col, matrix) {
+        col_pos[slm_col_slot(matrix, col->index)] = c++;
+    }
+
+    size_t *bounds = xmalloc((threads + 1) * sizeof(size_t));
+    slm_split_rows(bounds, threads, prefix, matrix->m);
+    slm_uf_bound(tasks, threads, bounds);
+    xfree(bounds);
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t].rows = rows;
+        tasks[t].col_pos = col_pos;
+        tasks[t].matrix = matrix;
+    }
+    slm_run_tasks(slm_uf_matrix_worker, tasks, sizeof(slm_uf_task_t), threads);
+    xfree(prefix);
+    xfree(rows);
+
+    slm_blocks_t *blocks = slm_blocks_label(tasks, threads, matrix->m, matrix->n);
+    xfree(tasks[0].parent);
+    xfree(tasks);
+    return blocks;
+}
+
+slm_blocks_t *slm_frozen_blocks_parallel(const slm_frozen_t *frozen, size_t threads)
+{
+    slm_uf_task_t *tasks = slm_uf_tasks(&threads, frozen->m, frozen->n);
+    size_t *bounds = xmalloc((threads + 1) * sizeof(size_t));
+    slm_split_rows(bounds, threads, frozen->row_ptr, frozen->m);
+    slm_uf_bound(tasks, threads, bounds);
+    xfree(bounds);
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t].frozen = frozen;
+    }
+    slm_run_tasks(slm_uf_frozen_worker, tasks, sizeof(slm_uf_task_t), threads);
+
+    slm_blocks_t *blocks = slm_blocks_label(tasks, threads, frozen->m, frozen->n);
+    xfree(tasks[0].parent);
+    xfree(tasks);
+    return blocks;
+}
+
+slm_blocks_t *slm_matrix_blocks(const slm_matrix_t *matrix)
+{
+    return slm_matrix_blocks_parallel(matrix, 1);
+}
+
+slm_blocks_t *slm_frozen_blocks(const slm_frozen_t *frozen)
+{
+    return slm_frozen_blocks_parallel(frozen, 1);
+}
+
+void slm_blocks_free(slm_blocks_t *blocks)
+{
+    xfree(blocks);
+}
+
+// Size the row and column lists of each block in `blk` for its share of `matrix`
+static void slm_block_resize(const slm_matrix_t *matrix, const slm_blocks_t *labels, slm_matrix_t **blk)
+{
+    // Rows and columns are visited in order, so the last of each block is its largest
+    size_t *max_row = xmalloc(2 * labels->count * sizeof(size_t));
+    size_t *max_col = max_row + labels->count;
+    size_t *rows = xcalloc(2 * labels->count, sizeof(size_t));
+    size_t *cols = rows + labels->count;
+    size_t r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        max_row[labels->row_block[r]] = row->index;
+        rows[labels->row_block[r++]]++;
+    }
+    size_t c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        max_col[labels->col_block[c]] = col->index;
+        cols[labels->col_block[c++]]++;
+    }
+    for (size_t b = 0; b < labels->count; b++) {
+        slm_matrix_reserve(blk[b], max_row[b], max_col[b], rows[b], cols[b]);
+    }
+    xfree(rows);
+    xfree(max_row);
+}
+
+size_t slm_block_split(const slm_matrix_t *matrix, const slm_blocks_t *labels, slm_matrix_t ***blocks)
+{
+    slm_matrix_settle(matrix);
+    slm_matrix_t **blk = xmalloc(labels->count * sizeof(slm_matrix_t *));
+    for (size_t b = 0; b < labels->count; b++) {
+        blk[b] = slm_matrix_new();
+    }
+    slm_block_resize(matrix, labels, blk);
+
+    size_t c = 0;
+    for_each_col_in_matrix(col, matrix) {
+        slm_append_col(blk[labels->col_block[c++]], col->index);
+    }
+    size_t r = 0;
+    for_each_row_in_matrix(row, matrix) {
+        slm_matrix_t *dst = blk[labels->row_block[r++]];
+        slm_vec_t *dst_row = slm_append_row(dst, row->index);
+        for_each_element_in_row(elem, row) {
+            slm_append_elem(dst, dst_row, slm_get_col(dst, elem->j));
+        }
+    }
+
+    *blocks = blk;
+    return labels->count;
+}
+
+size_t slm_block_split_move(slm_matrix_t *matrix, const slm_blocks_t *labels, slm_matrix_t ***blocks)
+{
+    slm_matrix_settle(matrix);
+    slm_matrix_t **blk = xmalloc(labels->count * sizeof(slm_matrix_t *));
+    for (size_t b = 0; b < labels->count; b++) {
+        blk[b] = xcalloc(1, sizeof(slm_matrix_t));
+        blk[b]->arena = matrix->arena;
+        __atomic_add_fetch(&matrix->arena->refs, 1, __ATOMIC_RELAXED);
+    }
+    slm_block_resize(matrix, labels, blk);
+
+    // Every element of a row lies in a column of the same block, so whole rows
+    // and columns move across with their element lists untouched
+    size_t r = 0;
+    for_each_row_in_matrix_safe(row, matrix) {
+        slm_matrix_t *dst = blk[labels->row_block[r++]];
+        slm_set_row(dst, row->index, row);
+        slm_link_vec(&dst->first_row, &dst->last_row, dst->last_row, row);
+        dst->m++;
+    }
+    size_t c = 0;
+    for_each_col_in_matrix_safe(col, matrix) {
+        slm_matrix_t *dst = blk[labels->col_block[c++]];
+        slm_set_col(dst, col->index, col);
+        slm_link_vec(&dst->first_col, &dst->last_col, dst->last_col, col);
+        dst->n++;
+    }
+
+    // Leave `matrix` empty, with an arena of its own and any index emptied
+    slm_arena_release(matrix->arena);
+    xfree(matrix->rows);
+    xfree(matrix->cols);
+    if (matrix->hash) {
+        memset(matrix->hash->slots, 0, matrix->hash->size * sizeof(slm_hash_slot_t));
+        matrix->hash->count = 0;
+    }
+    if (matrix->components) {
+        slm_components_free(matrix->components);
+        matrix->components = slm_components_new();
+    }
+    *matrix = (slm_matrix_t) {
+        .arena = slm_arena_new(),
+        .hash = matrix->hash,
+        .components = matrix->components,
+        .versions = matrix->versions,
+        .deferred = matrix->deferred
+    };
+    slm_versions_invalidate(matrix);
+
+    *blocks = blk;
+    return labels->count;
+}
+
+size_t slm_block_decompose(const slm_matrix_t *matrix, slm_matrix_t ***blocks)
+{
+    slm_blocks_t *labels = slm_matrix_blocks(matrix);
+    const size_t count = slm_block_split(matrix, labels, blocks);
+    slm_blocks_free(labels);
+    return count;
+}
+
+size_t slm_frozen_matching(const slm_frozen_t *frozen, size_t *row_match, size_t *col_match)
+{
+    const size_t m = frozen->m;
+    const size_t *row_ptr = frozen->row_ptr;
+    const slm_index_t *row_elems = frozen->row_elems;
+    for (size_t r = 0; r < m; r++) {
+        row_match[r] = SLM_UNMATCHED;
+    }
+    for (size_t c = 0; c < frozen->n; c++) {
+        col_match[c] = SLM_UNMATCHED;
+    }
+
+    size_t *dist = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *queue = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *cursor = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *path = xmalloc((m ? m : 1) * sizeof(size_t));
+
+    // Start from a greedy matching, which leaves few augmenting paths to find. Rows with fewer elements go
+    // first, and each takes its free column with the fewest elements, so the choices block each other less
+    size_t width = 0;
+    for (size_t r = 0; r < m; r++) {
+        width = row_ptr[r + 1] - row_ptr[r] > width ? row_ptr[r + 1] - row_ptr[r] : width;
+    }
+    size_t *starts = xcalloc(width + 2, sizeof(size_t));
+    for (size_t r = 0; r < m; r++) {
+        starts[row_ptr[r + 1] - row_ptr[r] + 1]++;
+    }
+    for (size_t d = 1; d <= width + 1; d++) {
+        starts[d] += starts[d - 1];
+    }
+    for (size_t r = 0; r < m; r++) {
+        queue[starts[row_ptr[r + 1] - row_ptr[r]]++] = r;
+    }
+    xfree(starts);
+
+    size_t count = 0;
+    for (size_t k = 0; k < m; k++) {
+        const size_t r = queue[k];
+        size_t best = SLM_UNMATCHED;
+        size_t fewest = SIZE_MAX;
+        for (size_t e = row_ptr[r]; e < row_ptr[r + 1]; e++) {
+            const size_t c = row_elems[e];
+            if ((col_match[c] == SLM_UNMATCHED) && (frozen->col_ptr[c + 1] - frozen->col_ptr[c] < fewest)) {
+                best = c;
+                fewest = frozen->col_ptr[c + 1] - frozen->col_ptr[c];
+            }
+        }
+        if (best != SLM_UNMATCHED) {
+            row_match[r] = best;
+            col_match[best] = r;
+            count++;
+        }
+    }
+
+    while (count < m) {
+        // Layer the rows by their distance along alternating paths from the unmatched rows, stopping at the
+        // layer that first reaches an unmatched column
+        size_t head = 0;
+        size_t tail = 0;
+        for (size_t r = 0; r < m; r++) {
+            dist[r] = row_match[r] == SLM_UNMATCHED ? 0 : SLM_UNMATCHED;
+            if (!dist[r]) {
+                queue[tail++] = r;
+            }
+        }
+        size_t limit = SLM_UNMATCHED;
+        while ((head < tail) && (dist[queue[head]] < limit)) {
+            const size_t r = queue[head++];
+            for (size_t e = row_ptr[r]; e < row_ptr[r + 1]; e++) {
+                const size_t w = col_match[row_elems[e]];
+                if (w == SLM_UNMATCHED) {
+                    limit = dist[r] + 1;
+                }
+                else if (dist[w] == SLM_UNMATCHED) {
+                    dist[w] = dist[r] + 1;
+                    queue[tail++] = w;
+                }
+            }
+        }
+        if (limit == SLM_UNMATCHED) {
+            break;
+        }
+
+        // Augment along disjoint shortest paths, found by depth-first search down the layers. Every
+        // edge is tried at most once per phase, and a row found to lead nowhere leaves the layers
+        for (size_t r = 0; r < m; r++) {
+            cursor[r] = row_ptr[r];
+        }
+        for (size_t root = 0; root < m; root++) {
+            if (row_match[root] != SLM_UNMATCHED) {
+                continue;
+            }
+            // `queue` holds the rows of the path so far, and `path` the column taken from each
+            size_t depth = 0;
+            queue[0] = root;
+            while (true) {
+                const size_t r = queue[depth];
+                bool found = false;
+                bool deeper = false;
+                while (cursor[r] < row_ptr[r + 1]) {
+                    const size_t c = row_elems[cursor[r]++];
+                    const size_t w = col_match[c];
+                    if (w == SLM_UNMATCHED) {
+                        path[depth] = c;
+                        found = true;
+                        break;
+                    }
+                    if ((dist[w] == dist[r] + 1) && (dist[w] < limit)) {
+                        path[depth] = c;
+                        queue[++depth] = w;
+                        deeper = true;
+                        break;
+                    }
+                }
+                if (found) {
+                    for (size_t k = 0; k <= depth; k++) {
+                        row_match[queue[k]] = path[k];
+                        col_match[path[k]] = queue[k];
+                    }
+                    count++;
+                    break;
+                }
+                if (!deeper) {
+                    dist[r] = SLM_UNMATCHED;
+                    if (!depth) {
+                        break;
+                    }
+                    depth--;
+                }
+            }
+        }
+    }
+
+    xfree(path);
+    xfree(cursor);
+    xfree(queue);
+    xfree(dist);
+    return count;
+}
+
+// Sides of the coarse decomposition
+enum {
+    SLM_DM_NONE,
+    SLM_DM_UNDER,
+    SLM_DM_SQUARE,
+    SLM_DM_OVER
+};
+
+// Label the rows and columns of `frozen` with their side of the coarse decomposition, given the maximum matching of `dm`
+static void slm_dm_coarse(const slm_frozen_t *frozen, const slm_dm_t *dm, uint8_t *row_side, uint8_t *col_side, size_t *queue)
+{
+    // The underdetermined part holds the columns reachable from an unmatched column along alternating paths,
+    // and every row of those columns
+    size_t tail = 0;
+    for (size_t c = 0; c < dm->n; c++) {
+        if (dm->col_match[c] == SLM_UNMATCHED) {
+            col_side[c] = SLM_DM_UNDER;
+            queue[tail++] = c;
+        }
+    }
+    for (size_t head = 0; head < tail; head++) {
+        const size_t c = queue[head];
+        for (size_t e = frozen->col_ptr[c]; e < frozen->col_ptr[c + 1]; e++) {
+            const size_t r = frozen->col_elems[e];
+            if (row_side[r] == SLM_DM_NONE) {
+                row_side[r] = SLM_DM_UNDER;
+                const size_t next = dm->row_match[r];
+                if ((next != SLM_UNMATCHED) && (col_side[next] == SLM_DM_NONE)) {
+                    col_side[next] = SLM_DM_UNDER;
+                    queue[tail++] = next;
+                }
+            }
+        }
+    }
+
+    // The overdetermined part likewise holds the rows reachable from an unmatched row, and every column of those rows
+    tail = 0;
+    for (size_t r = 0; r < dm->m; r++) {
+        if (dm->row_match[r] == SLM_UNMATCHED) {
+            row_side[r] = SLM_DM_OVER;
+            queue[tail++] = r;
+        }
+    }
+    for (size_t head = 0; head < tail; head++) {
+        const size_t r = queue[head];
+        for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+            const size_t c = frozen->row_elems[e];
+            if (col_side[c] == SLM_DM_NONE) {
+                col_side[c] = SLM_DM_OVER;
+                const size_t next = dm->col_match[c];
+                if ((next != SLM_UNMATCHED) && (row_side[next] == SLM_DM_NONE)) {
+                    row_side[next] = SLM_DM_OVER;
+                    queue[tail++] = next;
+                }
+            }
+        }
+    }
+
+    // The rest are matched to each other, and make up the square part
+    for (size_t r = 0; r < dm->m; r++) {
+        row_side[r] = row_side[r] == SLM_DM_NONE ? SLM_DM_SQUARE : row_side[r];
+    }
+    for (size_t c = 0; c < dm->n; c++) {
+        col_side[c] = col_side[c] == SLM_DM_NONE ? SLM_DM_SQUARE : col_side[c];
+    }
+}
+
+// Store the strongly connected components of the square part of `frozen` to `rows`, as runs of rows bounded by `bounds`,
+// in an order where each row's elements lie in its own component or a later one. Returns the number of components
+//
+// Each row of the square part stands for itself and its matched column, and has an edge to each row matched to
+// one of its columns. Components are found by Tarjan's algorithm, without recursion so that depth is unbounded
+static size_t slm_dm_fine(const slm_frozen_t *frozen, const slm_dm_t *dm, const uint8_t *row_side, const uint8_t *col_side, size_t *rows, size_t *bounds)
+{
+    const size_t m = dm->m;
+    size_t *order = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *low = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *calls = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *cursor = xmalloc((m ? m : 1) * sizeof(size_t));
+    size_t *stack = xmalloc((m ? m : 1) * sizeof(size_t));
+    for (size_t r = 0; r < m; r++) {
+        order[r] = SLM_UNMATCHED;
+    }
+
+    // Components come out of Tarjan's algorithm after every component they reach, so they are stored back to front
+    size_t next = 0;
+    size_t stacked = 0;
+    size_t filled = dm->row_coarse[2] - dm->row_coarse[1];
+    size_t count = 0;
+    for (size_t root = 0; root < m; root++) {
+        if ((row_side[root] != SLM_DM_SQUARE) || (order[root] != SLM_UNMATCHED)) {
+            continue;
+        }
+        size_t depth = 0;
+        calls[0] = root;
+        cursor[root] = frozen->row_ptr[root];
+        order[root] = low[root] = next++;
+        stack[stacked++] = root;
+        while (true) {
+            const size_t r = calls[depth];
+            bool deeper = false;
+            while (cursor[r] < frozen->row_ptr[r + 1]) {
+                const size_t c = frozen->row_elems[cursor[r]++];
+                if (col_side[c] != SLM_DM_SQUARE) {
+                    continue;
+                }
+                const size_t w = dm->col_match[c];
+                if (order[w] == SLM_UNMATCHED) {
+                    cursor[w] = frozen->row_ptr[w];
+                    order[w] = low[w] = next++;
+                    stack[stacked++] = w;
+                    calls[++depth] = w;
+                    deeper = true;
+                    break;
+                }
+                // Only rows still stacked count, as finished ones have had `low` cleared
+                low[r] = order[w] < low[r] && low[w] != SLM_UNMATCHED ? order[w] : low[r];
+            }
+            if (deeper) {
+                continue;
+            }
+
+            if (low[r] == order[r]) {
+                const size_t end = filled;
+                size_t w;
+                do {
+                    w = stack[--stacked];
+                    low[w] = SLM_UNMATCHED;
+                    rows[--filled] = w;
+                } while (w != r);
+                bounds[count++] = end;
+            }
+            if (!depth) {
+                break;
+            }
+            depth--;
+            const size_t parent = calls[depth];
+            low[parent] = low[r] < low[parent] ? low[r] : low[parent];
+        }
+    }
+
+    // `bounds` holds the end of each component, last first; turn it into the start of each, first first, then the end
+    for (size_t b = 0; b < count / 2; b++) {
+        const size_t swap = bounds[b];
+        bounds[b] = bounds[count - 1 - b];
+        bounds[count - 1 - b] = swap;
+    }
+    for (size_t b = count; b > 0; b--) {
+        bounds[b] = bounds[b - 1];
+    }
+    bounds[0] = 0;
+
+    xfree(stack);
+    xfree(cursor);
+    xfree(calls);
+    xfree(low);
+    xfree(order);
+    return count;
+}
+
+slm_dm_t *slm_frozen_dmperm(const slm_frozen_t *frozen)
+{
+    const size_t m = frozen->m;
+    const size_t n = frozen->n;
+    const size_t pairs = m < n ? m : n;
+    const size_t blocks = pairs + 3;
+    slm_dm_t *dm = xmalloc(sizeof(slm_dm_t) + (2 * m + 2 * n + 2 * blocks) * sizeof(size_t));
+    *dm = (slm_dm_t) {
+        .m = m,
+        .n = n,
+        .row_match = (size_t *)(dm + 1),
+        .col_match = (size_t *)(dm + 1) + m,
+        .row_perm = (size_t *)(dm + 1) + m + n,
+        .col_perm = (size_t *)(dm + 1) + 2 * m + n,
+        .row_ptr = (size_t *)(dm + 1) + 2 * m + 2 * n,
+        .col_ptr = (size_t *)(dm + 1) + 2 * m + 2 * n + blocks
+    };
+    dm->rank = slm_frozen_matching(frozen, dm->row_match, dm->col_match);
+
+    uint8_t *row_side = xcalloc(m + n + 1, sizeof(uint8_t));
+    uint8_t *col_side = row_side + m;
+    size_t *queue = xmalloc((m + n + 1) * sizeof(size_t));
+    slm_dm_coarse(frozen, dm, row_side, col_side, queue);
+
+    // Unmatched columns first, then the underdetermined rows along with their matched columns
+    size_t rk = 0;
+    size_t ck = 0;
+    for (size_t c = 0; c < n; c++) {
+        if (dm->col_match[c] == SLM_UNMATCHED) {
+            dm->col_perm[ck++] = c;
+        }
+    }
+    dm->col_coarse[1] = ck;
+    for (size_t r = 0; r < m; r++) {
+        if (row_side[r] == SLM_DM_UNDER) {
+            dm->row_perm[rk++] = r;
+            dm->col_perm[ck++] = dm->row_match[r];
+        }
+    }
+    dm->row_coarse[1] = rk;
+    dm->col_coarse[2] = ck;
+    for (size_t r = 0; r < m; r++) {
+        rk += row_side[r] == SLM_DM_SQUARE;
+    }
+    dm->row_coarse[2] = rk;
+
+    // The square part, one irreducible block after another, each row beside its matched column
+    size_t *bounds = queue;
+    const size_t fine = slm_dm_fine(frozen, dm, row_side, col_side, dm->row_perm + dm->row_coarse[1], bounds);
+    for (size_t k = dm->row_coarse[1]; k < rk; k++) {
+        dm->col_perm[ck++] = dm->row_match[dm->row_perm[k]];
+    }
+    dm->col_coarse[3] = ck;
+
+    // Then the overdetermined rows, matched ones first, with the columns of the matched ones
+    for (size_t r = 0; r < m; r++) {
+        if ((row_side[r] == SLM_DM_OVER) && (dm->row_match[r] != SLM_UNMATCHED)) {
+            dm->row_perm[rk++] = r;
+            dm->col_perm[ck++] = dm->row_match[r];
+        }
+    }
+    dm->row_coarse[3] = rk;
+    for (size_t r = 0; r < m; r++) {
+        if (dm->row_match[r] == SLM_UNMATCHED) {
+            dm->row_perm[rk++] = r;
+        }
+    }
+    dm->row_coarse[4] = m;
+    dm->col_coarse[4] = n;
+
+    // The underdetermined and overdetermined parts each make one block, around those of the square part
+    size_t count = 0;
+    if (dm->col_coarse[2]) {
+        dm->row_ptr[count] = 0;
+        dm->col_ptr[count] = 0;
+        count++;
+    }
+    for (size_t b = 0; b < fine; b++) {
+        dm->row_ptr[count] = dm->row_coarse[1] + bounds[b];
+        dm->col_ptr[count] = dm->col_coarse[2] + bounds[b];
+        count++;
+    }
+    if (dm->row_coarse[2] < m) {
+        dm->row_ptr[count] = dm->row_coarse[2];
+        dm->col_ptr[count] = dm->col_coarse[3];
+        count++;
+    }
+    dm->row_ptr[count] = m;
+    dm->col_ptr[count] = n;
+    dm->count = count;
+
+    xfree(queue);
+    xfree(row_side);
+    return dm;
+}
+
+slm_dm_t *slm_matrix_dmperm(const slm_matrix_t *matrix)
+{
+    // Hopcroft-Karp passes over every element once per phase, which the compressed arrays serve far faster than the lists
+    slm_frozen_t *frozen = slm_matrix_freeze(matrix);
+    slm_dm_t *dm = slm_frozen_dmperm(frozen);
+    slm_frozen_free(frozen);
+    return dm;
+}
+
+void slm_dm_free(slm_dm_t *dm)
+{
+    xfree(dm);
+}
+
+static bool slm_partition_parallel(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B, size_t threads)
+{
+    slm_blocks_t *labels = slm_matrix_blocks_parallel(matrix, threads);
+    if (labels->count < 2) {
+        slm_blocks_free(labels);
+        return false;
+    }
+
+    slm_blocks_fold(labels);
+
+    slm_matrix_t **blk;
+    slm_block_split(matrix, labels, &blk);
+    slm_blocks_free(labels);
+    slm_partition_finish(blk, A, B);
+    return true;
+}
+
+bool slm_diagonal_partition_parallel(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B, size_t threads)
+{
+    slm_matrix_settle(matrix);
+    const uint64_t start = slm_stat_clock();
+    const bool split = slm_partition_parallel(matrix, A, B, threads);
+    slm_stat_partition(start);
+    return split;
+}
+
+// Share of a product handled by a single thread
+typedef struct slm_mul_task_t {
+    slm_vec_t *const *rows; // rows of the left operand, by position
+    const slm_matrix_t *B; // right operand
+    size_t begin; // first row position
+    size_t end; // one past the last row position
+    size_t *marker; // last row position to produce each column of `B`, if any, by `slm_col_slot`
+    size_t *i; // row index of every product element, in row-major order
+    size_t *j; // column index of every product element, in row-major order
+    size_t count; // number of product elements
+    size_t size; // current memory allocation for `i` and `j`
+} slm_mul_task_t;
+
+// Gustavson's algorithm: each row of the product is the union of the rows of `B`
+// selected by the same row of the left operand. Every column of `B` carries a
+// marker holding the last row position to produce it, so repeats are dropped
+// without clearing anything between rows
+static void *slm_mul_worker(void *arg)
+{
+    slm_mul_task_t *task = arg;
+    const slm_matrix_t *B = task->B;
+    task->marker = xmalloc((slm_col_slots(B) + 1) * sizeof(size_t));
+    memset(task->marker, 0xff, (slm_col_slots(B) + 1) * sizeof(size_t));
+
+    for (size_t r = task->begin; r < task->end; r++) {
+        const slm_vec_t *row = task->rows[r];
+        const size_t first = task->count;
+        for_each_element_in_row(elem, row) {
+            const slm_vec_t *b_row = slm_get_row(B, elem->j);
+            if (!b_row) {
+                continue;
+            }
+            if (task->count + b_row->length > task->size) {
+                task->size = 2 * (task->count + b_row->length);
+                task->i = xrealloc(task->i, task->size * sizeof(size_t));
+                task->j = xrealloc(task->j, task->size * sizeof(size_t));
+            }
+            for_each_element_in_row(b_elem, b_row) {
+                size_t *marker = &task->marker[slm_col_slot(B, b_elem->j)];
+                if (*marker != r) {
+                    *marker = r;
+                    task->i[task->count] = row->index;
+                    task->j[task->count++] = b_elem->j;
+                }
+            }
+        }
+        if (task->count > first) {
+            qsort(task->j + first, task->count - first, sizeof(size_t), slm_index_compare);
+        }
+    }
+    return NULL;
+}
+
+slm_matrix_t *slm_matrix_mul_parallel(const slm_matrix_t *A, const slm_matrix_t *B, size_t threads)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    threads = threads ? threads : 1;
+    threads = (threads > A->m) && A->m ? A->m : threads;
+
+    // Balance threads by the number of elements of `B` each row of `A` draws on
+    slm_vec_t **rows = xmalloc(A->m * sizeof(slm_vec_t *));
+    size_t *prefix = xmalloc((A->m + 1 + threads + 1) * sizeof(size_t));
+    size_t *bounds = prefix + A->m + 1;
+    size_t r = 0;
+    prefix[0] = 0;
+    for_each_row_in_matrix(row, A) {
+        size_t work = 0;
+        for_each_element_in_row(elem, row) {
+            const slm_vec_t *b_row = slm_get_row(B, elem->j);
+            work += b_row ? b_row->length : 0;
+        }
+        prefix[r + 1] = prefix[r] + work;
+        rows[r++] = row;
+    }
+    slm_split_rows(bounds, threads, prefix, A->m);
+
+    slm_mul_task_t *tasks = xcalloc(threads, sizeof(slm_mul_task_t));
+    for (size_t t = 0; t < threads; t++) {
+        tasks[t].rows = rows;
+        tasks[t].B = B;
+        tasks[t].begin = bounds[t];
+        tasks[t].end = bounds[t + 1];
+    }
+    slm_run_tasks(slm_mul_worker, tasks, sizeof(slm_mul_task_t), threads);
+    xfree(prefix);
+    xfree(rows);
+
+    // Every thread produced whole rows in order, each sorted by column, so the
+    // product is assembled by appending alone: first the columns any thread
+    // marked, then each row along with its elements
+    slm_matrix_t *product = slm_matrix_new();
+    if (A->m && B->n) {
+        slm_matrix_reserve(product, A->last_row->index, B->last_col->index, A->m, B->n);
+    }
+    for_each_col_in_matrix(col, B) {
+        for (size_t t = 0; t < threads; t++) {
+            if (tasks[t].marker[slm_col_slot(B, col->index)] != SIZE_MAX) {
+                slm_append_col(product, col->index);
+                break;
+            }
+        }
+    }
+    for (size_t t = 0; t < threads; t++) {
+        slm_vec_t *row = NULL;
+        for (size_t k = 0; k < tasks[t].count; k++) {
+            if (!row || (row->index != tasks[t].i[k])) {
+                row = slm_append_row(product, tasks[t].i[k]);
+            }
+            slm_append_elem(product, row, slm_get_col(product, tasks[t].j[k]));
+        }
+        xfree(tasks[t].marker);
+        xfree(tasks[t].i);
+        xfree(tasks[t].j);
+    }
+    xfree(tasks);
+    return product;
+}
+
+slm_matrix_t *slm_matrix_mul(const slm_matrix_t *A, const slm_matrix_t *B)
+{
+    return slm_matrix_mul_parallel(A, B, 1);
+}
+
+// Share of a text input parsed by a single thread
+typedef struct slm_read_task_t {
+    const char *begin; // first byte of the chunk, at the start of a line
+    const char *end; // one past the last byte of the chunk, at the start of a line or the end of the input
+    size_t *i; // row index of every entry parsed
+    size_t *j; // column index of every entry parsed
+    size_t count; // number of lines in the chunk, then number of entries parsed
+    size_t lines; // number of entry lines parsed, before mirroring
+    size_t expected; // number of entry lines the whole input must hold, or `SIZE_MAX` if any number will do
+    size_t base; // index of the first row and column: 1 for Matrix Market, 0 for edge lists
+    size_t max_i; // largest row index allowed
+    size_t max_j; // largest column index allowed
+    bool mirror; // add the transpose of every entry as well
+    bool failed; // set on a malformed line
+} slm_read_task_t;
+
+static inline bool slm_read_blank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+// Parse the decimal integer at `*p`, ahead of `end`, to `value` and advance past it
+// Returns false if there is none, or it does not fit in `slm_index_t`
+static inline bool slm_read_index(const char **p, const char *end, size_t *value)
+{
+    const char *s = *p;
+    while ((s < end) && slm_read_blank(*s)) {
+        s++;
+    }
+    if ((s == end) || ((unsigned)(*s - '0') > 9)) {
+        return false;
+    }
+    size_t v = 0;
+    for (; (s < end) && ((unsigned)(*s - '0') <= 9); s++) {
+        const size_t digit = (size_t)(*s - '0');
+        if (v > (SLM_INDEX_MAX - digit) / 10) {
+            return false;
+        }
+        v = 10 * v + digit;
+    }
+    *p = s;
+    *value = v;
+    return true;
+}
+
+// Return the start of the line following the one containing `p`
+static inline const char *slm_read_next_line(const char *p, const char *end)
+{
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    return eol ? eol + 1 : end;
+}
+
+static void *slm_read_count_worker(void *arg)
+{
+    slm_read_task_t *task = arg;
+    task->count = 0;
+    for (const char *p = task->begin; p < task->end; p = slm_read_next_line(p, task->end)) {
+        task->count++;
+    }
+    return NULL;
+}
+
+// Parse every line of the chunk as a pair of indices followed by anything, skipping blank lines and comments
+static void *slm_read_parse_worker(void *arg)
+{
+    slm_read_task_t *task = arg;
+    size_t count = 0;
+    task->lines = 0;
+    for (const char *p = task->begin; p < task->end;) {
+        const char *next = slm_read_next_line(p, task->end);
+        while ((p < next) && slm_read_blank(*p)) {
+            p++;
+        }
+        if ((p == next) || (*p == '\n') || (*p == '%') || (*p == '#')) {
+            p = next;
+            continue;
+        }
+
+        size_t m;
+        size_t n;
+        if (!slm_read_index(&p, next, &m) || !slm_read_index(&p, next, &n) ||
+            ((p < next) && !slm_read_blank(*p) && (*p != '\n')) ||
+            (m < task->base) || (n < task->base) || (m - task->base > task->max_i) || (n - task->base > task->max_j)) {
+            task->failed = true;
+            break;
+        }
+        task->i[count] = m - task->base;
+        task->j[count++] = n - task->base;
+        task->lines++;
+        if (task->mirror && (m != n)) {
+            task->i[count] = n - task->base;
+            task->j[count++] = m - task->base;
+        }
+        p = next;
+    }
+    task->count = count;
+    return NULL;
+}
+
+// Parse the lines from `data` up to `end` using up to `threads` threads, and build a matrix of the entries
+// The text is read in place, with only the parsed indices held in memory alongside it
+static slm_matrix_t *slm_read_entries(const char *data, const char *end, size_t threads, const slm_read_task_t *proto)
+{
+    // Keep at least a megabyte of text per thread
+    const size_t size = (size_t)(end - data);
+    threads = threads ? threads : 1;
+    threads = (threads > size / (1 << 20) + 1) ? size / (1 << 20) + 1 : threads;
+
+    // Chunks start on line boundaries, so every line falls to exactly one thread
+    slm_read_task_t *tasks = xmalloc(threads * sizeof(slm_read_task_t));
+    const char *begin = data;
+    for (size_t t = 0; t < threads; t++) {
+        const char *split = (t + 1 == threads) ? end : data + size / threads * (t + 1);
+        tasks[t] = *proto;
+        tasks[t].begin = begin;
+        if (split > begin) {
+            begin = (split < end) ? slm_read_next_line(split - 1, end) : end;
+        }
+        tasks[t].end = begin;
+    }
+
+    // Size the output of each chunk by its line count, then parse every chunk into its own share
+    slm_run_tasks(slm_read_count_worker, tasks, sizeof(slm_read_task_t), threads);
+    const size_t per_line = proto->mirror ? 2 : 1;
+    size_t capacity = 0;
+    for (size_t t = 0; t < threads; t++) {
+        capacity += tasks[t].count * per_line;
+    }
+    size_t *i = xmalloc(capacity * sizeof(size_t));
+    size_t *j = xmalloc(capacity * sizeof(size_t));
+    for (size_t t = 0, k = 0; t < threads; t++) {
+        tasks[t].i = i + k;
+        tasks[t].j = j + k;
+        k += tasks[t].count * per_line;
+    }
+    slm_run_tasks(slm_read_parse_worker, tasks, sizeof(slm_read_task_t), threads);
+
+    // Close the gaps left by comments and blank lines
+    size_t nnz = 0;
+    size_t lines = 0;
+    bool failed = false;
+    for (size_t t = 0; t < threads; t++) {
+        memmove(i + nnz, tasks[t].i, tasks[t].count * sizeof(size_t));
+        memmove(j + nnz, tasks[t].j, tasks[t].count * sizeof(size_t));
+        nnz += tasks[t].count;
+        lines += tasks[t].lines;
+        failed |= tasks[t].failed;
+    }
+    failed |= (proto->expected != SIZE_MAX) && (lines != proto->expected);
+    xfree(tasks);
 
-    fprintf(f, "%zu rows by %zu cols\n", matrix->m, matrix->n);
-    slm_print(f, matrix);
+    slm_matrix_t *matrix = failed ? NULL : slm_matrix_from_coo(i, j, nnz);
+    xfree(i);
+    xfree(j);
+    return matrix;
 }
 
-size_t slm_total_elements(slm_matrix_t *matrix)
+slm_matrix_t *slm_matrix_read_edges(const char *path, size_t threads)
 {
-    size_t count = 0;
-    for_each_row_in_matrix(row, matrix) {
-        count += row->length;
+    void *map;
+    size_t size;
+    if (!slm_map_file(path, &map, &size)) {
+        return NULL;
     }
-    return count;
+    if (!map) {
+        return slm_matrix_new();
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const slm_read_task_t proto = {
+        .base = 0,
+        .max_i = SLM_INDEX_MAX,
+        .max_j = SLM_INDEX_MAX,
+        .expected = SIZE_MAX
+    };
+    slm_matrix_t *matrix = slm_read_entries(map, (const char *)map + size, threads, &proto);
+    munmap(map, size);
+    return matrix;
 }
 
-static bool slm_matrix_reachability(slm_matrix_t *matrix, slm_vec_t *row)
+slm_matrix_t *slm_matrix_read_mtx(const char *path, size_t threads)
 {
-    size_t rows_visited = 0;
-    size_t cols_visited = 0;
-    bool out = false;
+    void *map;
+    size_t size;
+    if (!slm_map_file(path, &map, &size)) {
+        return NULL;
+    }
+    if (!map) {
+        return NULL;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char *p = map;
+    const char *end = p + size;
 
-    typedef struct stack_frame_t {
-        slm_vec_t *row;
-        slm_vec_t *col;
-        slm_elem_t *xm; // row-iterating element
-        slm_elem_t *xn; // column-iterating element
-        bool stat;
-        void *ret_addr;
-    } stack_frame_t;
+    // Banner: %%MatrixMarket matrix coordinate <field> <symmetry>
+    char banner[128] = { 0 };
+    const char *next = slm_read_next_line(p, end);
+    memcpy(banner, p, (size_t)(next - p) < sizeof(banner) - 1 ? (size_t)(next - p) : sizeof(banner) - 1);
+    for (char *c = banner; *c; c++) {
+        *c = (*c >= 'A' && *c <= 'Z') ? (char)(*c - 'A' + 'a') : *c;
+    }
+    char object[16] = { 0 };
+    char format[16] = { 0 };
+    char field[16] = { 0 };
+    char symmetry[16] = { 0 };
+    const bool valid = (sscanf(banner, "%%%%matrixmarket %15s %15s %15s %15s", object, format, field, symmetry) == 4) &&
+                       !strcmp(object, "matrix") && !strcmp(format, "coordinate");
 
-    ptrdiff_t stack_depth = 0;
-    ptrdiff_t frame_capacity = 4096;
-    stack_frame_t *stk = xmalloc(frame_capacity * sizeof(stack_frame_t));
-    stk[stack_depth] = (stack_frame_t) {
-        .row = row,
-        .col = NULL,
-        .xm = NULL,
-        .xn = NULL,
-        .stat = false,
-        .ret_addr = &&ret_addr_0
+    // Comments, then the size line: <rows> <columns> <entries>
+    size_t m = 0;
+    size_t n = 0;
+    size_t nnz = 0;
+    bool sized = false;
+    for (p = next; valid && !sized && (p < end); p = next) {
+        next = slm_read_next_line(p, end);
+        const char *q = p;
+        while ((q < next) && slm_read_blank(*q)) {
+            q++;
+        }
+        if ((q < next) && (*q != '%') && (*q != '\n')) {
+            sized = slm_read_index(&q, next, &m) && slm_read_index(&q, next, &n) && slm_read_index(&q, next, &nnz);
+            if (!sized) {
+                break;
+            }
+        }
+    }
+    if (!sized) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    const slm_read_task_t proto = {
+        .base = 1,
+        .max_i = m ? m - 1 : 0,
+        .max_j = n ? n - 1 : 0,
+        .expected = nnz,
+        .mirror = strcmp(symmetry, "general") != 0
     };
+    slm_matrix_t *matrix = slm_read_entries(p, end, threads, &proto);
+    munmap(map, size);
+    return matrix;
+}
 
-next_frame:
-    while (stack_depth >= 0) {
-        if (unlikely(stack_depth + 2 >= frame_capacity)) {
-            frame_capacity *= 2;
-            stk = xrealloc(stk, frame_capacity * sizeof(stack_frame_t));
-            fprintf(stderr, "resizing %s stack for %" PRIiPTR " frames\n", __FUNCTION__, frame_capacity);
-        }
-        stack_frame_t stk_top = stk[stack_depth--];
-        row = stk_top.row;
-        slm_vec_t *col = stk_top.col;
-        slm_elem_t *xm = stk_top.xm;
-        slm_elem_t *xn = stk_top.xn;
-        bool stat = stk_top.stat;
-        slm_vec_t *node = NULL;
-        goto *stk_top.ret_addr;
+// Rows are formatted in rounds of up to this many bytes of output per thread, bounding the memory held at once
+#define SLM_WRITE_BATCH ((size_t)1 << 20)
 
-ret_addr_0:
-        if (!row->flag) {
-            row->flag = true;
-            if (++rows_visited == matrix->m) {
-                out = true;
-                goto next_frame;
+// Share of an output round formatted by a single thread
+typedef struct slm_write_task_t {
+    slm_vec_t *const *rows; // rows of the matrix, by position
+    const slm_matrix_t *matrix;
+    slm_format_t format;
+    size_t begin; // first row position
+    size_t end; // one past the last row position
+    bool lead; // whether the first element of the share opens its line
+    char *buf; // formatted text
+    size_t length; // bytes of formatted text
+    size_t size; // current memory allocation for `buf`
+} slm_write_task_t;
+
+// Make room for `bytes` more bytes of output in `task`
+static inline char *slm_write_reserve(slm_write_task_t *task, size_t bytes)
+{
+    if (unlikely(task->length + bytes > task->size)) {
+        task->size = 2 * (task->length + bytes);
+        task->buf = xrealloc(task->buf, task->size);
+    }
+    return task->buf + task->length;
+}
+
+// Format `value` in decimal at `p`, returning the number of digits written
+static inline size_t slm_write_index(char *p, size_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (size_t k = 0; k < count; k++) {
+        p[k] = digits[count - 1 - k];
+    }
+    return count;
+}
+
+static void *slm_write_worker(void *arg)
+{
+    slm_write_task_t *task = arg;
+    const slm_matrix_t *matrix = task->matrix;
+    bool lead = task->lead;
+    for (size_t r = task->begin; r < task->end; r++) {
+        const slm_vec_t *row = task->rows[r];
+        if (task->format == SLM_FORMAT_DENSE) {
+            // Walk the row alongside the column list, as both are sorted by column
+            char *p = slm_write_reserve(task, 29 + matrix->n);
+            size_t len = slm_write_index(p, row->index);
+            for (; len < 7; len++) {
+                p[len] = ' ';
             }
-            for_each_stack_element_in_row (xm, row) {
-                col = slm_get_col(matrix, xm->j);
-                if (!col->flag) {
-                    stat = false;
-                    col->flag = true;
-                    if (++cols_visited == matrix->n) {
-                        stat = true;
-                        goto next_col;
-                    }
-                    for_each_stack_element_in_col (xn, col) {
-                        node = slm_get_row(matrix, xn->i);
-                        if (!node->flag) {
-                            stk[++stack_depth] = (stack_frame_t) {
-                                .row = row,
-                                .col = col,
-                                .xm = xm,
-                                .xn = xn,
-                                .stat = stat,
-                                .ret_addr = &&ret_addr_1
-                            };
-                            stk[++stack_depth] = (stack_frame_t) {
-                                .row = node,
-                                .col = NULL,
-                                .xm = NULL,
-                                .xn = NULL,
-                                .stat = false,
-                                .ret_addr = &&ret_addr_0
-                            };
-                            goto next_frame;
-ret_addr_1:
-                            if (out) {
-                                stat = true;
-                                goto next_col;
-                            }
-                        }
-                    }
-                    next_col:
-                    if (stat) {
-                        out = true;
-                        goto next_frame;
-                    }
+            p[len++] = '\t';
+            const slm_elem_t *elem = slm_elem_at(row->arena, row->first);
+            for_each_col_in_matrix(col, matrix) {
+                const bool set = elem && (elem->j == col->index);
+                p[len++] = set ? '1' : '-';
+                elem = set ? slm_elem_at(row->arena, elem->next_col) : elem;
+            }
+            p[len++] = '\n';
+            task->length += len;
+            continue;
+        }
+
+        char *p = slm_write_reserve(task, 42 * row->length);
+        size_t len = 0;
+        for_each_element_in_row(elem, row) {
+            if (task->format == SLM_FORMAT_CSR) {
+                if (!lead) {
+                    p[len++] = ' ';
                 }
+                lead = false;
+                len += slm_write_index(p + len, elem->j);
+                continue;
             }
+            const size_t base = (task->format == SLM_FORMAT_MTX);
+            len += slm_write_index(p + len, elem->i + base);
+            p[len++] = ' ';
+            len += slm_write_index(p + len, elem->j + base);
+            p[len++] = '\n';
         }
-        out = false;
-        goto next_frame;
+        task->length += len;
     }
+    return NULL;
+}
 
-    free(stk);
-    return out;
+// Write the text ahead of the rows in format `format`
+static bool slm_write_header(FILE *f, const slm_matrix_t *matrix, slm_format_t format, size_t nnz)
+{
+    const size_t m = slm_row_span(matrix);
+    const size_t n = slm_col_span(matrix);
+    switch (format) {
+        case SLM_FORMAT_DENSE:
+            return fprintf(f, "%zu rows by %zu cols\n", matrix->m, matrix->n) >= 0;
+        case SLM_FORMAT_MTX:
+            return fprintf(f, "%%%%MatrixMarket matrix coordinate pattern general\n%zu %zu %zu\n", m, n, nnz) >= 0;
+        case SLM_FORMAT_EDGES:
+            return true;
+        case SLM_FORMAT_CSR:
+            break;
+    }
+
+    // Row pointers cover every row number up to the last, so empty rows repeat the pointer before them
+    if (fprintf(f, "%zu %zu %zu\n", m, n, nnz) < 0) {
+        return false;
+    }
+    slm_write_task_t out = { 0 };
+    size_t k = 0;
+    size_t r = 0;
+    char *p = slm_write_reserve(&out, 21);
+    out.length += slm_write_index(p, 0);
+    for_each_row_in_matrix(row, matrix) {
+        // A gap of empty rows may be far longer than any batch, so flush within it
+        for (; r <= row->index; r++) {
+            p = slm_write_reserve(&out, 21);
+            p[0] = ' ';
+            out.length += 1 + slm_write_index(p + 1, k + (r == row->index ? row->length : 0));
+            if (out.length >= SLM_WRITE_BATCH) {
+                if (fwrite(out.buf, 1, out.length, f) != out.length) {
+                    xfree(out.buf);
+                    return false;
+                }
+                out.length = 0;
+            }
+        }
+        k += row->length;
+    }
+    p = slm_write_reserve(&out, 1);
+    p[0] = '\n';
+    out.length++;
+    const bool ok = fwrite(out.buf, 1, out.length, f) == out.length;
+    xfree(out.buf);
+    return ok;
 }
 
-bool slm_diagonal_partition(slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B)
+bool slm_matrix_write(FILE *f, const slm_matrix_t *matrix, slm_format_t format, size_t threads)
 {
-    if (!matrix->m) {
+    slm_matrix_settle(matrix);
+    if ((format == SLM_FORMAT_DENSE) && (!matrix->m || !matrix->n)) {
+        return true;
+    }
+    const size_t nnz = slm_total_elements(matrix);
+    if (!slm_write_header(f, matrix, format, nnz)) {
         return false;
     }
 
+    // Weigh rows by their approximate length of output, and cut them into pieces of
+    // about `SLM_WRITE_BATCH` bytes, formatted a round of `threads` pieces at a time
+    slm_vec_t **rows = xmalloc(matrix->m * sizeof(slm_vec_t *));
+    size_t *prefix = xmalloc((matrix->m + 1) * sizeof(size_t));
+    size_t r = 0;
+    prefix[0] = 0;
     for_each_row_in_matrix(row, matrix) {
-        row->flag = false;
+        prefix[r + 1] = prefix[r] + ((format == SLM_FORMAT_DENSE) ? matrix->n + 9 : 16 * row->length);
+        rows[r++] = row;
     }
-    for_each_col_in_matrix(col, matrix) {
-        col->flag = false;
+    threads = threads ? threads : 1;
+    size_t pieces = prefix[matrix->m] / SLM_WRITE_BATCH + 1;
+    pieces = (pieces + threads - 1) / threads * threads;
+    size_t *bounds = xmalloc((pieces + 1) * sizeof(size_t));
+    slm_split_rows(bounds, pieces, prefix, matrix->m);
+    xfree(prefix);
+
+    slm_write_task_t *tasks = xcalloc(threads, sizeof(slm_write_task_t));
+    bool ok = true;
+    bool lead = true;
+    for (size_t first = 0; ok && (first < pieces); first += threads) {
+        for (size_t t = 0; t < threads; t++) {
+            tasks[t].rows = rows;
+            tasks[t].matrix = matrix;
+            tasks[t].format = format;
+            tasks[t].begin = bounds[first + t];
+            tasks[t].end = bounds[first + t + 1];
+            tasks[t].lead = lead;
+            tasks[t].length = 0;
+            lead = lead && (tasks[t].begin == tasks[t].end);
+        }
+        slm_run_tasks(slm_write_worker, tasks, sizeof(slm_write_task_t), threads);
+        for (size_t t = 0; ok && (t < threads); t++) {
+            ok = !tasks[t].length || (fwrite(tasks[t].buf, 1, tasks[t].length, f) == tasks[t].length);
+        }
+    }
+    if (ok && (format == SLM_FORMAT_CSR)) {
+        ok = putc('\n', f) != EOF;
     }
 
-    if (slm_matrix_reachability(matrix, matrix->first_row)) {
-        return false;
+    for (size_t t = 0; t < threads; t++) {
+        xfree(tasks[t].buf);
     }
+    xfree(tasks);
+    xfree(bounds);
+    xfree(rows);
+    return ok && !ferror(f);
+}
 
-    *A = slm_matrix_new();
-    *B = slm_matrix_new();
+// Share of a set operation handled by a single thread
+typedef struct slm_setop_task_t {
+    slm_vec_t *const *a_rows; // row of the left operand at each row position, if any
+    slm_vec_t *const *b_rows; // row of the right operand at each row position, if any
+    slm_setop_t op;
+    size_t begin; // first row position
+    size_t end; // one past the last row position
+    size_t *i; // row index of every result element, in row-major order
+    size_t *j; // column index of every result element, in row-major order
+    size_t count; // number of result elements
+    size_t size; // current memory allocation for `i` and `j`
+} slm_setop_task_t;
 
-    for_each_row_in_matrix(row, matrix) {
-        slm_matrix_t *blk = row->flag ? *A : *B;
-        for_each_element_in_row(elem, row) {
-            slm_matrix_insert(blk, elem->i, elem->j);
+static inline void slm_setop_emit(slm_setop_task_t *task, size_t m, size_t n)
+{
+    task->i[task->count] = m;
+    task->j[task->count++] = n;
+}
+
+// Word of the bitset index `dense` covering indices `k` up to `k + 63`, where `k` is a multiple of 64
+static inline uint64_t slm_dense_word(const slm_dense_t *dense, size_t k)
+{
+    return (k >= dense->base) && (k - dense->base < dense->span) ? dense->bits[(k - dense->base) / 64] : 0;
+}
+
+static inline uint64_t slm_setop_word(slm_setop_t op, uint64_t a, uint64_t b)
+{
+    switch (op) {
+        case SLM_SETOP_OR:
+            return a | b;
+        case SLM_SETOP_AND:
+            return a & b;
+        case SLM_SETOP_XOR:
+            return a ^ b;
+        case SLM_SETOP_ANDNOT:
+            break;
+    }
+    return a & ~b;
+}
+
+// Emit row `m` of `a` `op` `b`, either of which may be missing, in column order
+static void slm_setop_row(slm_setop_task_t *task, size_t m, const slm_vec_t *a, const slm_vec_t *b)
+{
+    const slm_setop_t op = task->op;
+    const size_t length = (a ? a->length : 0) + (b ? b->length : 0);
+    if (task->count + length > task->size) {
+        task->size = 2 * (task->count + length);
+        task->i = xrealloc(task->i, task->size * sizeof(size_t));
+        task->j = xrealloc(task->j, task->size * sizeof(size_t));
+    }
+
+    if (!a || !b) {
+        const slm_vec_t *only = a ? a : b;
+        if (only && ((op == SLM_SETOP_OR) || (op == SLM_SETOP_XOR) || (a && (op == SLM_SETOP_ANDNOT)))) {
+            for_each_element_in_row(elem, only) {
+                slm_setop_emit(task, m, elem->j);
+            }
         }
+        return;
     }
 
-    if ((*A)->n > (*B)->n) {
-        slm_matrix_t *swap = *A;
-        *A = *B;
-        *B = swap;
+    if (a->dense && b->dense) {
+        // Both indices start on a word boundary, so the result is built a word at a time
+        const size_t lo = a->dense->base < b->dense->base ? a->dense->base : b->dense->base;
+        const size_t a_hi = a->dense->base + a->dense->span;
+        const size_t b_hi = b->dense->base + b->dense->span;
+        const size_t hi = a_hi > b_hi ? a_hi : b_hi;
+        for (size_t k = lo; k < hi; k += 64) {
+            uint64_t word = slm_setop_word(op, slm_dense_word(a->dense, k), slm_dense_word(b->dense, k));
+            for (; word; word &= word - 1) {
+                slm_setop_emit(task, m, k + (size_t)__builtin_ctzll(word));
+            }
+        }
+        return;
     }
-    return true;
+
+    if ((op == SLM_SETOP_AND) && (a->dense || b->dense)) {
+        // Probe the index of the dense row for every element of the other
+        const slm_vec_t *dense = a->dense ? a : b;
+        for_each_element_in_row(elem, dense == a ? b : a) {
+            if (slm_dense_get(dense->dense, elem->j) != SLM_NIL) {
+                slm_setop_emit(task, m, elem->j);
+            }
+        }
+        return;
+    }
+    if ((op == SLM_SETOP_ANDNOT) && b->dense) {
+        for_each_element_in_row(elem, a) {
+            if (slm_dense_get(b->dense, elem->j) == SLM_NIL) {
+                slm_setop_emit(task, m, elem->j);
+            }
+        }
+        return;
+    }
+
+    const bool keep_a = op != SLM_SETOP_AND;
+    const bool keep_b = (op == SLM_SETOP_OR) || (op == SLM_SETOP_XOR);
+    const bool keep_both = (op == SLM_SETOP_OR) || (op == SLM_SETOP_AND);
+    const slm_elem_t *x = slm_elem_at(a->arena, a->first);
+    const slm_elem_t *y = slm_elem_at(b->arena, b->first);
+    while (x || y) {
+        if (!y || (x && (x->j < y->j))) {
+            if (keep_a) {
+                slm_setop_emit(task, m, x->j);
+            }
+            x = slm_elem_at(a->arena, x->next_col);
+        }
+        else if (!x || (y->j < x->j)) {
+            if (keep_b) {
+                slm_setop_emit(task, m, y->j);
+            }
+            y = slm_elem_at(b->arena, y->next_col);
+        }
+        else {
+            if (keep_both) {
+                slm_setop_emit(task, m, x->j);
+            }
+            x = slm_elem_at(a->arena, x->next_col);
+            y = slm_elem_at(b->arena, y->next_col);
+        }
+    }
+}
+
+static void *slm_setop_worker(void *arg)
+{
+    slm_setop_task_t *task = arg;
+    for (size_t r = task->begin; r < task->end; r++) {
+        const slm_vec_t *a = task->a_rows[r];
+        const slm_vec_t *b = task->b_rows[r];
+        slm_setop_row(task, a ? a->index : b->index, a, b);
+    }
+    return NULL;
+}
+
+// Compute the elements of `A` `op` `B` on up to `*threads` threads, storing the number of tasks to `*threads`
+// Each task holds whole rows, in order, and the tasks follow one another
+static slm_setop_task_t *slm_setop_run(const slm_matrix_t *A, const slm_matrix_t *B, slm_setop_t op, size_t *threads)
+{
+    // Pair the rows of both operands by merging their row lists, skipping pairs that cannot produce anything
+    const size_t max_pairs = A->m + B->m;
+    slm_vec_t **a_rows = xmalloc((2 * max_pairs + 1) * sizeof(slm_vec_t *));
+    slm_vec_t **b_rows = a_rows + max_pairs;
+    size_t *prefix = xmalloc((max_pairs + 1) * sizeof(size_t));
+    size_t pairs = 0;
+    prefix[0] = 0;
+    slm_vec_t *a = A->first_row;
+    slm_vec_t *b = B->first_row;
+    while (a || b) {
+        slm_vec_t *x = (a && (!b || (a->index <= b->index))) ? a : NULL;
+        slm_vec_t *y = (b && (!a || (b->index <= a->index))) ? b : NULL;
+        a = x ? x->next : a;
+        b = y ? y->next : b;
+        if (((op == SLM_SETOP_AND) && (!x || !y)) || ((op == SLM_SETOP_ANDNOT) && !x)) {
+            continue;
+        }
+        a_rows[pairs] = x;
+        b_rows[pairs] = y;
+        prefix[pairs + 1] = prefix[pairs] + (x ? x->length : 0) + (y ? y->length : 0);
+        pairs++;
+    }
+
+    *threads = *threads ? *threads : 1;
+    *threads = (*threads > pairs) && pairs ? pairs : *threads;
+    size_t *bounds = xmalloc((*threads + 1) * sizeof(size_t));
+    slm_split_rows(bounds, *threads, prefix, pairs);
+    slm_setop_task_t *tasks = xcalloc(*threads, sizeof(slm_setop_task_t));
+    for (size_t t = 0; t < *threads; t++) {
+        tasks[t].a_rows = a_rows;
+        tasks[t].b_rows = b_rows;
+        tasks[t].op = op;
+        tasks[t].begin = bounds[t];
+        tasks[t].end = bounds[t + 1];
+    }
+    slm_run_tasks(slm_setop_worker, tasks, sizeof(slm_setop_task_t), *threads);
+    xfree(bounds);
+    xfree(prefix);
+    xfree(a_rows);
+    return tasks;
+}
+
+slm_matrix_t *slm_matrix_combine_parallel(const slm_matrix_t *A, const slm_matrix_t *B, slm_setop_t op, size_t threads)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    slm_setop_task_t *tasks = slm_setop_run(A, B, op, &threads);
+
+    // Each task holds whole rows, in order and sorted by column, so the result is
+    // assembled by appending alone: first every column in use, then each row
+    size_t max_i = 0;
+    size_t max_j = 0;
+    for (size_t t = 0; t < threads; t++) {
+        for (size_t k = 0; k < tasks[t].count; k++) {
+            max_j = tasks[t].j[k] > max_j ? tasks[t].j[k] : max_j;
+        }
+        max_i = tasks[t].count ? tasks[t].i[tasks[t].count - 1] : max_i;
+    }
+    slm_matrix_t *result = slm_matrix_new();
+    slm_matrix_reserve(result, max_i, max_j, A->m + B->m, A->n + B->n);
+
+    // Every column in use is one of `A` or, failing that, of `B`, flagged by its slot in either, and
+    // the columns of both are merged in order to append the flagged ones
+    const size_t a_slots = slm_col_slots(A);
+    bool *used = xcalloc(a_slots + slm_col_slots(B) + 1, sizeof(bool));
+    for (size_t t = 0; t < threads; t++) {
+        for (size_t k = 0; k < tasks[t].count; k++) {
+            const size_t n = tasks[t].j[k];
+            used[slm_get_col(A, n) ? slm_col_slot(A, n) : a_slots + slm_col_slot(B, n)] = true;
+        }
+    }
+    const slm_vec_t *a = A->first_col;
+    const slm_vec_t *b = B->first_col;
+    while (a || b) {
+        const slm_vec_t *x = (a && (!b || (a->index <= b->index))) ? a : NULL;
+        const slm_vec_t *y = (b && (!a || (b->index <= a->index))) ? b : NULL;
+        a = x ? x->next : a;
+        b = y ? y->next : b;
+        if (x ? used[slm_col_slot(A, x->index)] : used[a_slots + slm_col_slot(B, y->index)]) {
+            slm_append_col(result, x ? x->index : y->index);
+        }
+    }
+    xfree(used);
+
+    for (size_t t = 0; t < threads; t++) {
+        slm_vec_t *row = NULL;
+        for (size_t k = 0; k < tasks[t].count; k++) {
+            if (!row || (row->index != tasks[t].i[k])) {
+                row = slm_append_row(result, tasks[t].i[k]);
+            }
+            slm_append_elem(result, row, slm_get_col(result, tasks[t].j[k]));
+        }
+        xfree(tasks[t].i);
+        xfree(tasks[t].j);
+    }
+    xfree(tasks);
+    return result;
+}
+
+slm_matrix_t *slm_matrix_or(const slm_matrix_t *A, const slm_matrix_t *B)
+{
+    return slm_matrix_combine_parallel(A, B, SLM_SETOP_OR, 1);
+}
+
+slm_matrix_t *slm_matrix_and(const slm_matrix_t *A, const slm_matrix_t *B)
+{
+    return slm_matrix_combine_parallel(A, B, SLM_SETOP_AND, 1);
+}
+
+slm_matrix_t *slm_matrix_xor(const slm_matrix_t *A, const slm_matrix_t *B)
+{
+    return slm_matrix_combine_parallel(A, B, SLM_SETOP_XOR, 1);
+}
+
+slm_matrix_t *slm_matrix_andnot(const slm_matrix_t *A, const slm_matrix_t *B)
+{
+    return slm_matrix_combine_parallel(A, B, SLM_SETOP_ANDNOT, 1);
+}
+
+// Remove from `A` every element that `B` holds, or with `keep`, every element that `B` lacks
+// Rows and columns left empty are removed as well
+static void slm_matrix_filter(slm_matrix_t *A, const slm_matrix_t *B, bool keep)
+{
+    for_each_row_in_matrix_safe(row, A) {
+        const slm_vec_t *b_row = slm_get_row(B, row->index);
+        if (!b_row && !keep) {
+            continue;
+        }
+        bool invalidated = false;
+        const slm_elem_t *y = b_row ? slm_elem_at(b_row->arena, b_row->first) : NULL;
+        for (slm_link_t link = row->first, next = SLM_NIL; link; link = next) {
+            slm_elem_t *elem = slm_elem_at(A->arena, link);
+            next = elem->next_col;
+            bool found = false;
+            if (b_row && b_row->dense) {
+                found = slm_dense_get(b_row->dense, elem->j) != SLM_NIL;
+            }
+            else {
+                for (; y && (y->j < elem->j); y = slm_elem_at(b_row->arena, y->next_col));
+                found = y && (y->j == elem->j);
+            }
+            if (found == keep) {
+                continue;
+            }
+
+            if (!invalidated) {
+                if (A->components) {
+                    slm_components_invalidate(A->components, 2 * row->index);
+                }
+                slm_versions_touch(A, row->index);
+                invalidated = true;
+            }
+            slm_vec_t *col = slm_get_col(A, elem->j);
+            slm_unlink_from_row(row, elem);
+            slm_unlink_from_col(col, elem);
+            if (A->hash) {
+                slm_hash_remove(A->hash, elem->i, elem->j);
+            }
+            slm_elem_release(A->arena, elem, link);
+            if (!col->first) {
+                slm_matrix_remove_vec(A, col, false);
+            }
+        }
+        if (!row->first) {
+            slm_matrix_remove_vec(A, row, true);
+        }
+    }
+}
+
+// Insert into `A` every element of `B` that `A` lacks
+static void slm_matrix_merge(slm_matrix_t *A, const slm_matrix_t *B)
+{
+    size_t threads = 1;
+    slm_setop_task_t *tasks = slm_setop_run(B, A, SLM_SETOP_ANDNOT, &threads);
+    slm_matrix_insert_coo(A, tasks->i, tasks->j, tasks->count);
+    xfree(tasks->i);
+    xfree(tasks->j);
+    xfree(tasks);
+}
+
+// Remove every row of `A`, as `A` `op` `A` does for the operations that cancel out
+static void slm_matrix_clear(slm_matrix_t *A)
+{
+    while (A->first_row) {
+        slm_matrix_remove_row(A, A->first_row->index);
+    }
+}
+
+void slm_matrix_or_inplace(slm_matrix_t *A, const slm_matrix_t *B)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    if (A != B) {
+        slm_matrix_merge(A, B);
+    }
+}
+
+void slm_matrix_and_inplace(slm_matrix_t *A, const slm_matrix_t *B)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    if (A != B) {
+        slm_matrix_filter(A, B, true);
+    }
+}
+
+void slm_matrix_xor_inplace(slm_matrix_t *A, const slm_matrix_t *B)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    if (A == B) {
+        slm_matrix_clear(A);
+        return;
+    }
+    // Gather what `B` adds before removing what both hold
+    size_t threads = 1;
+    slm_setop_task_t *tasks = slm_setop_run(B, A, SLM_SETOP_ANDNOT, &threads);
+    slm_matrix_filter(A, B, false);
+    slm_matrix_insert_coo(A, tasks->i, tasks->j, tasks->count);
+    xfree(tasks->i);
+    xfree(tasks->j);
+    xfree(tasks);
+}
+
+void slm_matrix_andnot_inplace(slm_matrix_t *A, const slm_matrix_t *B)
+{
+    slm_matrix_settle(A);
+    slm_matrix_settle(B);
+    if (A == B) {
+        slm_matrix_clear(A);
+        return;
+    }
+    slm_matrix_filter(A, B, false);
 }
@@ -8,26 +8,198 @@
 #include <string.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <pthread.h>
+
+// Allocate elements and vectors from per-matrix slab pools rather than
+// one heap allocation each. Define as 0 to fall back to calloc/free per node
+#ifndef SLM_POOL
+    #define SLM_POOL 1
+#endif
+
+// Store row / column indices in 32 bits, and link elements through 32-bit slot
+// numbers within the matrix arena rather than through pointers
+// Requires `SLM_POOL`, and limits indices to `SLM_INDEX_MAX`
+#ifndef SLM_COMPACT
+    #define SLM_COMPACT 0
+#endif
+
+// Slabs hold at most 2^`SLM_SLAB_SHIFT` objects
+#define SLM_SLAB_SHIFT 16
+
+// Rows and columns of at least `SLM_DENSE_MIN` elements, spread over no more than
+// `SLM_DENSE_SPAN` times as many indices, gain a bitset index for constant-time
+// lookup, and lose it again once they fall below half of either bound
+// Define `SLM_DENSE_MIN` as 0 to keep every row and column a plain list
+#ifndef SLM_DENSE_MIN
+    #define SLM_DENSE_MIN 256
+#endif
+#define SLM_DENSE_SPAN 4
+
+// Row and column lists are looked up through a plain array indexed by number, until that array would span
+// more than `SLM_DIR_MIN` numbers with more than `SLM_DIR_SPARSE` of them unused per row or column,
+// whereupon it turns into an open-addressing hash table keyed by number
+#ifndef SLM_DIR_MIN
+    #define SLM_DIR_MIN 65536
+#endif
+#define SLM_DIR_SPARSE 16
+
+// Concurrent ingestion buffers up to `SLM_INGEST_BATCH` elements per shard before merging them into the matrix
+#ifndef SLM_INGEST_BATCH
+    #define SLM_INGEST_BATCH 65536
+#endif
+
+// Count list scans, allocations, resizes, and partition timings in `slm_stats_t`
+// Define as 1 to enable. When 0, the counters compile to nothing and `slm_stats_get` reports zeros
+#ifndef SLM_STATS
+    #define SLM_STATS 0
+#endif
 
 typedef struct slm_elem_t slm_elem_t;
+
+#if SLM_COMPACT
+typedef uint32_t slm_index_t;
+typedef uint32_t slm_link_t; // slot number of an element within its arena
+#define SLM_INDEX_MAX UINT32_MAX
+#define SLM_NIL 0
+#else
+typedef size_t slm_index_t;
+typedef slm_elem_t *slm_link_t;
+#define SLM_INDEX_MAX SIZE_MAX
+#define SLM_NIL NULL
+#endif
+
 struct slm_elem_t {
-    size_t i; // entry row index
-    size_t j; // entry column index
-    slm_elem_t *next_row;
-    slm_elem_t *prev_row;
-    slm_elem_t *next_col;
-    slm_elem_t *prev_col;
+    slm_index_t i; // entry row index
+    slm_index_t j; // entry column index
+    slm_link_t next_row;
+    slm_link_t prev_row;
+    slm_link_t next_col;
+    slm_link_t prev_col;
+};
+
+typedef struct slm_pool_t slm_pool_t;
+struct slm_pool_t {
+    void **slabs; // list of slab allocations, oldest first
+    size_t slabs_size; // current memory allocation for `slabs`
+    size_t count; // number of slabs allocated
+    size_t size; // size of a single pooled object
+    size_t used; // objects handed out from the newest slab
+    size_t capacity; // total objects in the newest slab
+    void *free_list; // recycled objects, linked through their first word
+};
+
+typedef struct slm_arena_t slm_arena_t;
+struct slm_arena_t {
+    slm_pool_t elems; // pool of `slm_elem_t`
+    slm_pool_t vecs; // pool of `slm_vec_t`
+    size_t refs; // number of matrices drawing from the arena, changed atomically
+};
+
+// Bitset index over the elements of a dense row / column, which remain linked as usual
+typedef struct slm_dense_t slm_dense_t;
+struct slm_dense_t {
+    size_t base; // index of bit 0, a multiple of 64
+    size_t span; // number of indices covered, a multiple of 64
+    uint64_t *bits; // bit `k` is set when the vector holds index `base + k`
+    slm_link_t *links; // element at index `base + k`, where bit `k` is set
 };
 
 typedef struct slm_vec_t slm_vec_t;
 struct slm_vec_t {
     slm_vec_t *next;
     slm_vec_t *prev;
-    slm_elem_t *first;
-    slm_elem_t *last;
+    slm_link_t first;
+    slm_link_t last;
     size_t index; // row / column number
     size_t length; // total row / column elements
-    bool flag; // indicate reachability
+    slm_arena_t *arena; // allocator of the vector's elements
+    slm_dense_t *dense; // bitset index, held only while the vector is dense
+    bool owns_arena; // standalone vector, with a private arena
+};
+
+// Slot of a point index, empty while `link` is nil
+typedef struct slm_hash_slot_t slm_hash_slot_t;
+struct slm_hash_slot_t {
+    slm_index_t i; // element row index
+    slm_index_t j; // element column index
+    slm_link_t link;
+};
+
+// Open-addressing (linear probing) index from row / column indices to elements
+typedef struct slm_hash_t slm_hash_t;
+struct slm_hash_t {
+    slm_hash_slot_t *slots;
+    size_t size; // number of slots, a power of two
+    size_t count; // number of occupied slots
+};
+
+// Connected components of a matrix, kept current as elements come and go. Row `m` is node `2m` and
+// column `n` is node `2n + 1` of a union-find forest, whose sets are also threaded into circular
+// member lists so that a component losing a row or column can be relabeled on its own
+typedef struct slm_components_t slm_components_t;
+struct slm_components_t {
+    size_t *parent; // union-find parent of each node
+    size_t *next; // next member of each node's set, or `SIZE_MAX` for nodes outside the matrix
+    size_t size; // number of nodes covered
+    size_t count; // number of components, once settled
+    size_t *stale; // roots of components that lost a row or column since last settled
+    size_t stale_count; // number of entries in `stale`
+    size_t stale_size; // current memory allocation for `stale`
+};
+
+// Bits of a row number resolved by each level of a snapshot's row tree
+#define SLM_SNAP_SHIFT 6
+
+// Row of a snapshot, never changed once published
+typedef struct slm_snap_row_t slm_snap_row_t;
+struct slm_snap_row_t {
+    size_t index; // row number
+    size_t length; // number of elements
+    slm_index_t cols[]; // column numbers, ascending
+};
+
+// Node of a snapshot's row tree, shared by every version that has not changed a row below it
+typedef struct slm_snap_node_t slm_snap_node_t;
+struct slm_snap_node_t {
+    size_t version; // number of the version that built the node, the only one that may still change it
+    size_t count; // number of occupied slots
+    void *slots[1 << SLM_SNAP_SHIFT]; // child nodes, or rows at the bottom level
+};
+
+// Read-only version of a matrix. Versions form a list, oldest first, and each one holds on to the nodes
+// and rows it was the last to reach, releasing them once it and every older version have been released
+typedef struct slm_snapshot_t slm_snapshot_t;
+struct slm_snapshot_t {
+    size_t version; // version number, one more than the version before
+    size_t m; // number of rows
+    size_t nnz; // number of elements
+    size_t height; // levels of `root`
+    slm_snap_node_t *root; // row tree, covering row numbers below 2^(`SLM_SNAP_SHIFT` * `height`)
+    size_t refs; // readers holding the version, plus one while it is the newest
+    void **retired; // nodes and rows this version reaches but no newer one does
+    size_t retired_count; // number of entries in `retired`
+    size_t retired_size; // current memory allocation for `retired`
+    slm_snapshot_t *newer; // next version, if any
+};
+
+// Snapshot history of a matrix, along with the rows changed since the newest version
+typedef struct slm_versions_t slm_versions_t;
+struct slm_versions_t {
+    slm_snapshot_t *oldest; // oldest version not yet reclaimed
+    slm_snapshot_t *newest; // version new snapshots share, unless rows changed since
+    size_t *dirty; // numbers of the rows changed since `newest`, possibly repeated
+    size_t dirty_count; // number of entries in `dirty`
+    size_t dirty_size; // current memory allocation for `dirty`
+    bool stale; // whether every row may have changed, as after a transpose
+};
+
+// Elements inserted into a matrix but not yet merged into its rows and columns
+typedef struct slm_pending_t slm_pending_t;
+struct slm_pending_t {
+    size_t *i; // row numbers, in order of insertion
+    size_t *j; // column numbers, in order of insertion
+    size_t count; // number of entries
+    size_t size; // current memory allocation for `i` and `j`
 };
 
 typedef struct slm_matrix_t slm_matrix_t;
@@ -40,8 +212,125 @@ struct slm_matrix_t {
     slm_vec_t **cols; // list of column-list heads
     size_t rows_size; // current memory allocation for all rows
     size_t cols_size; // current memory allocation for all columns
+    bool rows_sparse; // `rows` is a hash table of `rows_size` slots rather than an array indexed by row number
+    bool cols_sparse; // `cols` is a hash table of `cols_size` slots rather than an array indexed by column number
+    size_t m; // number of rows
+    size_t n; // number of columns
+    slm_arena_t *arena; // allocator for all rows, columns, and elements
+    slm_hash_t *hash; // point index of every element, if enabled
+    slm_components_t *components; // connected components, if tracked
+    slm_versions_t *versions; // snapshot history, once a snapshot has been taken
+    slm_pending_t *pending; // inserts not yet merged, if deferred
+    bool deferred; // whether inserts wait for the next read or `slm_matrix_flush`
+};
+
+// Read-only snapshot of a matrix in compressed row (CSR) and compressed column (CSC) form
+// Rows and columns are addressed by position, i.e., their rank among the non-empty rows / columns
+typedef struct slm_frozen_t slm_frozen_t;
+struct slm_frozen_t {
+    size_t m; // number of rows
+    size_t n; // number of columns
+    size_t nnz; // number of elements
+    size_t *row_ptr; // row `r` holds `row_elems[row_ptr[r]]` up to `row_elems[row_ptr[r + 1]]`
+    size_t *col_ptr; // column `c` holds `col_elems[col_ptr[c]]` up to `col_elems[col_ptr[c + 1]]`
+    slm_index_t *row_index; // row number of each row position, ascending
+    slm_index_t *col_index; // column number of each column position, ascending
+    slm_index_t *row_elems; // column position of every element, in row-major order
+    slm_index_t *col_elems; // row position of every element, in column-major order
+    void *map; // read-only file mapping holding the arrays, if loaded by `slm_matrix_map`
+    size_t map_size; // length of `map`
+    const slm_frozen_t *base; // snapshot owning the arrays, if a view of it
+};
+
+// Assignment of the rows and columns of a matrix to its independent diagonal blocks
+// Rows and columns are addressed by position, and blocks are numbered in order of their first row
+typedef struct slm_blocks_t slm_blocks_t;
+struct slm_blocks_t {
+    size_t count; // number of blocks
     size_t m; // number of rows
     size_t n; // number of columns
+    size_t *row_block; // block of each row position
+    size_t *col_block; // block of each column position
+};
+
+// Marks a row or column left out of a matching
+#define SLM_UNMATCHED SIZE_MAX
+
+// Dulmage-Mendelsohn decomposition of a matrix, ordering its rows and columns into block upper triangular form
+// Rows and columns are addressed by position. Block `b` holds rows `row_perm[row_ptr[b]]` up to `row_perm[row_ptr[b + 1]]`
+// and columns `col_perm[col_ptr[b]]` up to `col_perm[col_ptr[b + 1]]`, and no element lies left of its row's block.
+// The blocks are, in order: the underdetermined part, if any, with more columns than rows; each irreducible block of
+// the square part, with a matched element in every diagonal position; and the overdetermined part, if any
+typedef struct slm_dm_t slm_dm_t;
+struct slm_dm_t {
+    size_t m; // number of rows
+    size_t n; // number of columns
+    size_t rank; // size of a maximum matching, i.e., the structural rank
+    size_t *row_match; // column matched to each row, or `SLM_UNMATCHED`
+    size_t *col_match; // row matched to each column, or `SLM_UNMATCHED`
+    size_t *row_perm; // rows in block order
+    size_t *col_perm; // columns in block order
+    size_t count; // number of blocks
+    size_t *row_ptr; // start of each block within `row_perm`, then `m`
+    size_t *col_ptr; // start of each block within `col_perm`, then `n`
+    size_t row_coarse[5]; // start of the underdetermined, square, and matched overdetermined rows, of the unmatched rows, then `m`
+    size_t col_coarse[5]; // start of the unmatched columns, of the matched underdetermined, square, and overdetermined columns, then `n`
+};
+
+// Rows and columns visited by a reachability query, as bitsets indexed by row / column number, or for numbers
+// as scattered as those of a sparse directory, as hash tables of the visited numbers
+// Reusable across queries and matrices, but owned by one query at a time
+typedef struct slm_visited_t slm_visited_t;
+struct slm_visited_t {
+    uint64_t *rows; // bit `m` is set once row `m` has been visited, or with `row_keys`, once slot `m` is taken
+    uint64_t *cols; // bit `n` is set once column `n` has been visited, or with `col_keys`, once slot `n` is taken
+    size_t *row_keys; // number of the row in each taken slot, if the last query hashed row numbers
+    size_t *col_keys; // number of the column in each taken slot, if the last query hashed column numbers
+    size_t rows_size; // current memory allocation for `rows`, in words
+    size_t cols_size; // current memory allocation for `cols`, in words
+    size_t m; // number of row numbers, or of slots of `row_keys`, covered by the last query
+    size_t n; // number of column numbers, or of slots of `col_keys`, covered by the last query
+};
+
+// Elements buffered by one shard of a concurrent ingestion, padded to keep shards off each other's cache lines
+typedef struct slm_ingest_shard_t slm_ingest_shard_t;
+struct slm_ingest_shard_t {
+    pthread_mutex_t lock; // held while appending to or draining the shard
+    size_t *i; // row numbers of the buffered elements
+    size_t *j; // column numbers of the buffered elements
+    size_t count; // number of buffered elements
+    size_t size; // current memory allocation for `i` and `j`
+    char pad[64];
+};
+
+// Concurrent ingestion into a matrix. Each thread appends to a shard of its own, and whichever thread
+// fills a shard merges every shard into the matrix while the others carry on appending
+// Merges run one at a time, each linking over as many threads as there are shards by `slm_matrix_insert_coo_parallel`
+typedef struct slm_ingest_t slm_ingest_t;
+struct slm_ingest_t {
+    slm_matrix_t *matrix; // matrix merged into
+    slm_ingest_shard_t *shards;
+    size_t count; // number of shards
+    pthread_mutex_t merge; // held while merging into `matrix`
+};
+
+// Process-wide counters of library activity, gathered when `SLM_STATS` is enabled
+typedef struct slm_stats_t slm_stats_t;
+struct slm_stats_t {
+    uint64_t row_scan_steps; // elements passed over while inserting into the middle of a row
+    uint64_t col_scan_steps; // elements passed over while inserting into the middle of a column
+    uint64_t row_list_steps; // rows passed over while adding a row to the middle of a matrix
+    uint64_t col_list_steps; // columns passed over while adding a column to the middle of a matrix
+    uint64_t elem_allocs; // elements allocated
+    uint64_t elem_frees; // elements freed
+    uint64_t vec_allocs; // rows and columns allocated
+    uint64_t vec_frees; // rows and columns freed
+    uint64_t row_resizes; // reallocations of the row list of a matrix
+    uint64_t col_resizes; // reallocations of the column list of a matrix
+    uint64_t dfs_depth_max; // most frames held at once by the reachability search
+    uint64_t partitions; // calls to `slm_diagonal_partition` and its matrix variants
+    uint64_t partition_ns; // total time spent in those calls
+    uint64_t partition_ns_max; // longest of those calls
 };
 
 // Create an empty matrix
@@ -50,13 +339,15 @@ slm_matrix_t *slm_matrix_new(void);
 // Free a matrix, including all allocated rows, columns, and elements
 void slm_matrix_free(slm_matrix_t *matrix);
 
-// Create a new vector, capable of being either a row or column
+// Create a new standalone vector, capable of being either a row or column
 slm_vec_t *slm_vec_new(void);
 
 // Free a row, including all allocated elements
+// Pooled rows return their memory to the owning matrix for reuse
 void slm_row_free(slm_vec_t *row);
 
 // Free a column, including all allocated elements
+// Pooled columns return their memory to the owning matrix for reuse
 void slm_col_free(slm_vec_t *row);
 
 // Create a new matrix element and insert into row `row` at column index `n`
@@ -69,17 +360,46 @@ void slm_row_remove(slm_vec_t *row, size_t n);
 // Duplicate row `row`
 slm_vec_t *slm_row_dupl(slm_vec_t *row);
 
+// Return the number of column indices held by both rows `a` and `b`
+size_t slm_row_intersection_count(const slm_vec_t *a, const slm_vec_t *b);
+
+// Return the number of column indices held by either of rows `a` and `b`
+size_t slm_row_union_count(const slm_vec_t *a, const slm_vec_t *b);
+
+// Return the number of row indices held by both columns `a` and `b`
+size_t slm_col_intersection_count(const slm_vec_t *a, const slm_vec_t *b);
+
+// Return the number of row indices held by either of columns `a` and `b`
+size_t slm_col_union_count(const slm_vec_t *a, const slm_vec_t *b);
+
 // Create a new matrix element
 slm_elem_t *slm_elem_new(void);
 
 // Return the `m`th row of matrix `matrix`
-slm_vec_t *slm_get_row(slm_matrix_t *matrix, size_t m);
+slm_vec_t *slm_get_row(const slm_matrix_t *matrix, size_t m);
 
 // Return the `n`th column of matrix `matrix`
-slm_vec_t *slm_get_col(slm_matrix_t *matrix, size_t n);
+slm_vec_t *slm_get_col(const slm_matrix_t *matrix, size_t n);
 
 // Duplicate matrix `matrix`
-slm_matrix_t *slm_matrix_dupl(slm_matrix_t *matrix);
+slm_matrix_t *slm_matrix_dupl(const slm_matrix_t *matrix);
+
+// Transpose matrix `matrix` in place, in time linear in its number of elements and without allocating
+// Its hash index and tracked components, if any, are carried over
+void slm_matrix_transpose_inplace(slm_matrix_t *matrix);
+
+// Create a matrix from `nnz` coordinate pairs (`i[k]`, `j[k]`), given in any order
+// Duplicate pairs are ignored
+slm_matrix_t *slm_matrix_from_coo(const size_t *i, const size_t *j, size_t nnz);
+
+// Insert `nnz` coordinate pairs (`i[k]`, `j[k]`), given in any order, into matrix `matrix`
+// Runs in time linear in `nnz` plus the number of rows and columns of `matrix`
+void slm_matrix_insert_coo(slm_matrix_t *matrix, const size_t *i, const size_t *j, size_t nnz);
+
+// Counterpart of `slm_matrix_insert_coo` that links elements into their rows, then their columns, over up to
+// `threads` threads, each taking a disjoint range of whole rows or columns. Sorting and updating the hash index,
+// tracked components, and snapshot history stay on the calling thread
+void slm_matrix_insert_coo_parallel(slm_matrix_t *matrix, const size_t *i, const size_t *j, size_t nnz, size_t threads);
 
 // Remove (and free memory allocated for) the row at index `m` from matrix `matrix`
 void slm_matrix_remove_row(slm_matrix_t *matrix, size_t m);
@@ -87,65 +407,349 @@ void slm_matrix_remove_row(slm_matrix_t *matrix, size_t m);
 // Remove (and free memory allocated for) the column at index `n` from matrix `matrix`
 void slm_matrix_remove_col(slm_matrix_t *matrix, size_t n);
 
+// Remove the rows at the `k` indices `idx` from matrix `matrix`, in ascending order whatever the order of `idx`
+// Indices of missing rows, and repeats, are ignored
+void slm_matrix_remove_rows(slm_matrix_t *matrix, const size_t *idx, size_t k);
+
+// Remove the columns at the `k` indices `idx` from matrix `matrix`, in ascending order whatever the order of `idx`
+// Indices of missing columns, and repeats, are ignored
+void slm_matrix_remove_cols(slm_matrix_t *matrix, const size_t *idx, size_t k);
+
+// Release the parts of the row and column lists of matrix `matrix` past its last row and column,
+// switching either between an array and a hash table to suit how densely its numbers are used
+void slm_matrix_shrink(slm_matrix_t *matrix);
+
 // Create a new matrix element and insert into matrix `matrix` at
 // row index `m` and column index `n`
 void slm_matrix_insert(slm_matrix_t *matrix, size_t m, size_t n);
 
+// Log inserts into matrix `matrix` rather than making them at once if `defer`, or merge the log and stop logging if not
+// `slm_matrix_flush`, or the next call that modifies `matrix`, sorts the log and merges it in one pass over each touched
+// row and column, so bursts of out-of-order inserts scan no lists. Calls taking `matrix` as `const`, including
+// `slm_get_row`, `slm_get_col` and the traversal macros, merge the log too: one reader merges it under a lock while
+// any others wait, so concurrent readers stay safe, though inserts still must not race with reads
+void slm_matrix_defer(slm_matrix_t *matrix, bool defer);
+
+// Merge every deferred insert into matrix `matrix`, safely against other threads flushing or reading it
+void slm_matrix_flush(slm_matrix_t *matrix);
+
+// Keep a hash index of every element of matrix `matrix`, making point lookups constant-time
+// The index follows changes made through `slm_matrix_*` functions, but not through `slm_row_*` on its rows
+void slm_matrix_index(slm_matrix_t *matrix);
+
+// Drop the hash index of matrix `matrix`, if any
+void slm_matrix_unindex(slm_matrix_t *matrix);
+
+// Return the element at row index `m` and column index `n` of matrix `matrix`, or NULL if there is none
+slm_elem_t *slm_matrix_find(const slm_matrix_t *matrix, size_t m, size_t n);
+
+// Return whether matrix `matrix` holds an element at row index `m` and column index `n`
+bool slm_matrix_contains(const slm_matrix_t *matrix, size_t m, size_t n);
+
+// Look up the `count` points (`i[k]`, `j[k]`) of matrix `matrix`, storing whether each is present to `found[k]`
+// Probes of an indexed matrix are prefetched ahead of time. Returns the number of points present
+size_t slm_matrix_contains_batch(const slm_matrix_t *matrix, const size_t *i, const size_t *j, bool *found, size_t count);
+
 // Return the total number of elements in matrix `matrix`
-size_t slm_total_elements(slm_matrix_t *matrix);
+size_t slm_total_elements(const slm_matrix_t *matrix);
 
 // Dump matrix to file `f`
-void slm_matrix_print(FILE *f, slm_matrix_t *matrix);
+void slm_matrix_print(FILE *f, const slm_matrix_t *matrix);
+
+// Text formats of `slm_matrix_write`
+typedef enum slm_format_t {
+    SLM_FORMAT_DENSE, // the grid of `slm_matrix_print`
+    SLM_FORMAT_MTX, // Matrix Market coordinate pattern, as read by `slm_matrix_read_mtx`
+    SLM_FORMAT_EDGES, // one 0-based `row column` pair per line, as read by `slm_matrix_read_edges`
+    SLM_FORMAT_CSR, // `rows cols elements`, then a line of row pointers and a line of column indices
+} slm_format_t;
+
+// Write matrix `matrix` to file `f` in format `format`, formatting rows on up to `threads` threads
+// Returns false on a write error
+bool slm_matrix_write(FILE *f, const slm_matrix_t *matrix, slm_format_t format, size_t threads);
 
 // Perform a partitioning of matrix `matrix` into a diagonal block matrix of the form
 // | `A` 0 |
 // | 0 `B` |
 // with `A` being the maximal block reduction of `matrix` and `B` being the remainder
-bool slm_diagonal_partition(slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B);
+// Leaves `matrix` untouched beyond merging deferred inserts, so any number of threads may partition the same
+// matrix at once
+bool slm_diagonal_partition(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B);
+
+// Counterpart of `slm_diagonal_partition` that records visited rows and columns in `visited` rather than in
+// per-thread scratch space
+bool slm_diagonal_partition_visited(const slm_matrix_t *matrix, slm_visited_t *visited, slm_matrix_t **restrict A, slm_matrix_t **restrict B);
+
+// Return whether every row and column of matrix `matrix` is reachable from its first row
+// When not, `visited` is left holding exactly the rows and columns that are
+bool slm_matrix_connected(const slm_matrix_t *matrix, slm_visited_t *visited);
+
+// Create an empty visited set
+slm_visited_t *slm_visited_new(void);
+
+// Free a visited set
+void slm_visited_free(slm_visited_t *visited);
+
+// Return whether row `m` was visited by the last query using `visited`
+bool slm_visited_row(const slm_visited_t *visited, size_t m);
+
+// Return whether column `n` was visited by the last query using `visited`
+bool slm_visited_col(const slm_visited_t *visited, size_t n);
+
+// Counterpart of `slm_diagonal_partition` that moves the rows and columns of `matrix` into `A` and `B` without
+// copying any element, leaving `matrix` empty. `A` and `B` share an allocator, so may not be modified concurrently,
+// though each may be freed on any thread, its nodes returning to the allocator once both are freed
+bool slm_diagonal_partition_move(slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B);
+
+// Create a read-only compressed snapshot of matrix `matrix`
+slm_frozen_t *slm_matrix_freeze(const slm_matrix_t *matrix);
+
+// Create a (mutable) matrix from the snapshot `frozen`
+slm_matrix_t *slm_matrix_thaw(const slm_frozen_t *frozen);
+
+// Free a snapshot
+void slm_frozen_free(slm_frozen_t *frozen);
+
+// Duplicate snapshot `frozen`
+slm_frozen_t *slm_frozen_dupl(const slm_frozen_t *frozen);
+
+// Return a view of the transpose of snapshot `frozen`, sharing its arrays without copying any
+// The view serves every `slm_frozen_*` call, i.e., traversal, printing, partitions, block labels, and matchings,
+// but not calls on matrices such as `slm_matrix_mul` or the set operations, which need it thawed, i.e., copied
+// The view must be freed with `slm_frozen_free` before `frozen` is
+slm_frozen_t *slm_frozen_transpose_view(const slm_frozen_t *frozen);
+
+// Return the total number of elements in snapshot `frozen`
+size_t slm_frozen_total_elements(const slm_frozen_t *frozen);
+
+// Dump snapshot to file `f`, in the same format as `slm_matrix_print`
+void slm_frozen_print(FILE *f, const slm_frozen_t *frozen);
+
+// Return a read-only version of matrix `matrix` as it stands, sharing every row unchanged since the last one
+// Call from the thread writing to `matrix`, then hand the snapshot to any number of reader threads. The first
+// call copies every row, and later ones copy just the rows changed since. Versions are reference-counted, and
+// this function frees released ones, oldest first, so snapshots never block the writer, but all must be released
+// before `matrix` is freed
+slm_snapshot_t *slm_matrix_snapshot(slm_matrix_t *matrix);
+
+// Release snapshot `snapshot`, from any thread
+void slm_snapshot_release(slm_snapshot_t *snapshot);
+
+// Return the column numbers of row `m` of snapshot `snapshot`, ascending, storing their number to `length`
+// Returns NULL if the row is empty
+const slm_index_t *slm_snapshot_row(const slm_snapshot_t *snapshot, size_t m, size_t *length);
+
+// Return whether snapshot `snapshot` holds an element at row `m` and column `n`
+bool slm_snapshot_contains(const slm_snapshot_t *snapshot, size_t m, size_t n);
+
+// Return the total number of elements in snapshot `snapshot`
+size_t slm_snapshot_total_elements(const slm_snapshot_t *snapshot);
+
+// Create a compressed snapshot of snapshot `snapshot`, for the partitions and labelings of `slm_frozen_t`
+slm_frozen_t *slm_snapshot_freeze(const slm_snapshot_t *snapshot);
+
+// Start concurrent ingestion into matrix `matrix`, over `shards` buffers (at least one)
+// Until `slm_ingest_free`, `matrix` must only be changed or read through the ingestion
+slm_ingest_t *slm_ingest_new(slm_matrix_t *matrix, size_t shards);
+
+// Insert an element at row `m` and column `n`, from any thread
+// The element reaches the matrix by the next merge, which this call runs if it fills its shard and no merge is underway
+void slm_ingest_insert(slm_ingest_t *ingest, size_t m, size_t n);
+
+// Merge every element inserted before this call into the matrix, from any thread
+void slm_ingest_flush(slm_ingest_t *ingest);
+
+// Flush, then take a snapshot of the matrix, from any thread
+slm_snapshot_t *slm_ingest_snapshot(slm_ingest_t *ingest);
+
+// Flush, then end concurrent ingestion, handing the matrix back to the caller
+void slm_ingest_free(slm_ingest_t *ingest);
+
+// Read the Matrix Market coordinate file `path`, parsing it with up to `threads` threads
+// Values are ignored, and symmetric matrices are expanded in full. Returns NULL on failure, including when
+// the number of entries differs from the one given on the size line
+slm_matrix_t *slm_matrix_read_mtx(const char *path, size_t threads);
+
+// Read the edge list `path`, one `source target` pair of 0-based indices per line, parsing it with
+// up to `threads` threads. Lines starting with `#` or `%` are comments. Returns NULL on failure
+slm_matrix_t *slm_matrix_read_edges(const char *path, size_t threads);
+
+// Write matrix `matrix` to the file `path` in the binary snapshot format. Returns false on failure
+bool slm_matrix_save(const slm_matrix_t *matrix, const char *path);
+
+// Write snapshot `frozen` to the file `path` in the binary snapshot format. Returns false on failure
+bool slm_frozen_save(const slm_frozen_t *frozen, const char *path);
+
+// Load the binary snapshot file `path` as a snapshot whose arrays are mapped straight from the file,
+// or copied if it was written with a different `SLM_COMPACT` setting. Returns NULL on failure
+// Only the header and array sizes are checked, so the file must have been written by `slm_frozen_save`
+slm_frozen_t *slm_matrix_map(const char *path);
+
+// Snapshot counterpart of `slm_diagonal_partition`, producing snapshots `A` and `B`
+bool slm_frozen_diagonal_partition(const slm_frozen_t *frozen, slm_frozen_t **restrict A, slm_frozen_t **restrict B);
+
+// Label every row and column of matrix `matrix` with its diagonal block
+slm_blocks_t *slm_matrix_blocks(const slm_matrix_t *matrix);
+
+// Track the connected components of matrix `matrix` as elements are inserted and rows / columns removed,
+// so that block queries need not search the matrix. Follows changes made through `slm_matrix_*` functions,
+// and is used by `slm_diagonal_partition` and `slm_matrix_blocks` whenever it is settled
+void slm_matrix_track_components(slm_matrix_t *matrix);
+
+// Stop tracking the connected components of matrix `matrix`, if tracked
+void slm_matrix_untrack_components(slm_matrix_t *matrix);
+
+// Return the number of independent diagonal blocks of matrix `matrix`, settling its tracked components if any
+// Only components that lost a row or column since the last query are relabeled
+size_t slm_matrix_component_count(slm_matrix_t *matrix);
+
+// Label every row and column of snapshot `frozen` with its diagonal block
+slm_blocks_t *slm_frozen_blocks(const slm_frozen_t *frozen);
+
+// Label the rows and columns of matrix `matrix` using up to `threads` threads
+slm_blocks_t *slm_matrix_blocks_parallel(const slm_matrix_t *matrix, size_t threads);
+
+// Label the rows and columns of snapshot `frozen` using up to `threads` threads
+slm_blocks_t *slm_frozen_blocks_parallel(const slm_frozen_t *frozen, size_t threads);
+
+// Free a block labeling
+void slm_blocks_free(slm_blocks_t *blocks);
+
+// Split matrix `matrix` into the blocks of labeling `labels`, leaving `matrix` intact
+// Stores an array of the blocks, in order of their first row, to `blocks` and returns its length
+size_t slm_block_split(const slm_matrix_t *matrix, const slm_blocks_t *labels, slm_matrix_t ***blocks);
+
+// Move the rows, columns, and elements of matrix `matrix` into the blocks of labeling `labels`, leaving `matrix` empty
+// No element is copied, and the blocks share the allocator of `matrix`, so no two of them may be modified concurrently,
+// though each may be freed on any thread, its nodes returning to the allocator once every block is freed
+// Stores an array of the blocks, in order of their first row, to `blocks` and returns its length
+size_t slm_block_split_move(slm_matrix_t *matrix, const slm_blocks_t *labels, slm_matrix_t ***blocks);
+
+// Split matrix `matrix` into all of its independent diagonal blocks at once, leaving `matrix` intact
+// Stores an array of the blocks, in order of their first row, to `blocks` and returns its length
+size_t slm_block_decompose(const slm_matrix_t *matrix, slm_matrix_t ***blocks);
+
+// Find a maximum matching between the rows and columns of snapshot `frozen` by Hopcroft-Karp, storing the column
+// matched to each row to `row_match` and the row matched to each column to `col_match`. Returns the size of the matching
+size_t slm_frozen_matching(const slm_frozen_t *frozen, size_t *row_match, size_t *col_match);
+
+// Dulmage-Mendelsohn decomposition of snapshot `frozen`
+slm_dm_t *slm_frozen_dmperm(const slm_frozen_t *frozen);
+
+// Dulmage-Mendelsohn decomposition of matrix `matrix`, addressing rows and columns by their position in its lists
+slm_dm_t *slm_matrix_dmperm(const slm_matrix_t *matrix);
+
+// Free a Dulmage-Mendelsohn decomposition
+void slm_dm_free(slm_dm_t *dm);
+
+// Counterpart of `slm_diagonal_partition` that labels the blocks of `matrix` using up to `threads` threads
+bool slm_diagonal_partition_parallel(const slm_matrix_t *matrix, slm_matrix_t **restrict A, slm_matrix_t **restrict B, size_t threads);
+
+// Boolean product of matrices `A` and `B`, holding element (`i`, `j`) whenever
+// row `i` of `A` and column `j` of `B` have an index in common
+slm_matrix_t *slm_matrix_mul(const slm_matrix_t *A, const slm_matrix_t *B);
+
+// Counterpart of `slm_matrix_mul` that computes the rows of the product using up to `threads` threads
+slm_matrix_t *slm_matrix_mul_parallel(const slm_matrix_t *A, const slm_matrix_t *B, size_t threads);
+
+// Element-wise operations of `slm_matrix_combine_parallel`
+typedef enum slm_setop_t {
+    SLM_SETOP_OR, // elements of either operand
+    SLM_SETOP_AND, // elements of both operands
+    SLM_SETOP_XOR, // elements of exactly one operand
+    SLM_SETOP_ANDNOT, // elements of the left operand but not the right
+} slm_setop_t;
+
+// Return a new matrix holding `A` `op` `B`, merging the rows of both operands in a single pass
+// and computing rows on up to `threads` threads
+slm_matrix_t *slm_matrix_combine_parallel(const slm_matrix_t *A, const slm_matrix_t *B, slm_setop_t op, size_t threads);
+
+// Return a new matrix holding the elements of either `A` or `B`
+slm_matrix_t *slm_matrix_or(const slm_matrix_t *A, const slm_matrix_t *B);
+
+// Return a new matrix holding the elements of both `A` and `B`
+slm_matrix_t *slm_matrix_and(const slm_matrix_t *A, const slm_matrix_t *B);
+
+// Return a new matrix holding the elements of exactly one of `A` and `B`
+slm_matrix_t *slm_matrix_xor(const slm_matrix_t *A, const slm_matrix_t *B);
+
+// Return a new matrix holding the elements of `A` that `B` lacks
+slm_matrix_t *slm_matrix_andnot(const slm_matrix_t *A, const slm_matrix_t *B);
+
+// Insert every element of `B` into `A`
+void slm_matrix_or_inplace(slm_matrix_t *A, const slm_matrix_t *B);
+
+// Remove every element of `A` that `B` lacks
+void slm_matrix_and_inplace(slm_matrix_t *A, const slm_matrix_t *B);
+
+// Remove every element of `A` that `B` holds, and insert every element of `B` that `A` lacks
+void slm_matrix_xor_inplace(slm_matrix_t *A, const slm_matrix_t *B);
+
+// Remove every element of `A` that `B` holds
+void slm_matrix_andnot_inplace(slm_matrix_t *A, const slm_matrix_t *B);
+
+// Store the current value of every counter to `stats`
+void slm_stats_get(slm_stats_t *stats);
+
+// Zero every counter
+void slm_stats_reset(void);
 
 #ifndef unlikely
     #define unlikely(x) __builtin_expect((x), 0)
 #endif
 
+// Return the element reachable through `link`, within arena `arena`
+#if SLM_COMPACT
+    #define slm_elem_at(arena, link) \
+        ((link) ? (slm_elem_t *)(arena)->elems.slabs[(link) >> SLM_SLAB_SHIFT] + ((link) & ((1u << SLM_SLAB_SHIFT) - 1)) : NULL)
+#else
+    #define slm_elem_at(arena, link) ((void)(arena), (link))
+#endif
+
 #define for_each_element_in_vec_safe(elem, vec, next_field) \
-    for (slm_elem_t *elem = (vec)->first, *next_##elem = NULL; \
-         (elem) && ((next_##elem) = ((elem)->next_##next_field), 1); \
+    for (slm_elem_t *elem = slm_elem_at((vec)->arena, (vec)->first), *next_##elem = NULL; \
+         (elem) && ((next_##elem) = slm_elem_at((vec)->arena, (elem)->next_##next_field), 1); \
          (elem) = (next_##elem))
 
 #define for_each_element_in_row_safe(elem, vec) \
-    for (slm_elem_t *elem = (vec)->first, *next_##elem = NULL; \
-         (elem) && ((next_##elem) = ((elem)->next_col), 1); \
+    for (slm_elem_t *elem = slm_elem_at((vec)->arena, (vec)->first), *next_##elem = NULL; \
+         (elem) && ((next_##elem) = slm_elem_at((vec)->arena, (elem)->next_col), 1); \
          (elem) = (next_##elem))
 
 #define for_each_element_in_col_safe(elem, vec) \
-    for (slm_elem_t *elem = (vec)->first, *next_##elem = NULL; \
-         (elem) && ((next_##elem) = ((elem)->next_row), 1); \
+    for (slm_elem_t *elem = slm_elem_at((vec)->arena, (vec)->first), *next_##elem = NULL; \
+         (elem) && ((next_##elem) = slm_elem_at((vec)->arena, (elem)->next_row), 1); \
          (elem) = (next_##elem))
 
+// Merge any inserts deferred on `matrix` before it is read, as every call taking it, even as `const`, does first
+#define slm_matrix_settle(matrix) \
+    ((void)(unlikely(__atomic_load_n(&(matrix)->pending, __ATOMIC_ACQUIRE) != NULL) && \
+            (slm_matrix_flush((slm_matrix_t *)(matrix)), 1)))
+
 #define for_each_col_in_matrix_safe(col, matrix) \
-    for (slm_vec_t *col = (matrix)->first_col, *next_##col = NULL; \
+    for (slm_vec_t *col = (slm_matrix_settle(matrix), (matrix)->first_col), *next_##col = NULL; \
          (col) && ((next_##col) = ((col)->next), 1); \
          (col) = (next_##col))
 
 #define for_each_row_in_matrix_safe(row, matrix) \
-    for (slm_vec_t *row = (matrix)->first_row, *next_##row = NULL; \
+    for (slm_vec_t *row = (slm_matrix_settle(matrix), (matrix)->first_row), *next_##row = NULL; \
          (row) && ((next_##row) = ((row)->next), 1); \
          (row) = (next_##row))
 
 #define for_each_row_in_matrix(row, matrix) \
-    for (slm_vec_t *row = (matrix)->first_row; (row); row = (row)->next)
+    for (slm_vec_t *row = (slm_matrix_settle(matrix), (matrix)->first_row); (row); row = (row)->next)
 
 #define for_each_col_in_matrix(col, matrix) \
-    for (slm_vec_t *col = (matrix)->first_col; (col); col = (col)->next)
+    for (slm_vec_t *col = (slm_matrix_settle(matrix), (matrix)->first_col); (col); col = (col)->next)
 
 #define for_each_element_in_row(elem, row) \
-    for (slm_elem_t *elem = (row)->first; (elem); (elem) = (elem)->next_col)
+    for (slm_elem_t *elem = slm_elem_at((row)->arena, (row)->first); (elem); (elem) = slm_elem_at((row)->arena, (elem)->next_col))
 
 #define for_each_element_in_col(elem, col) \
-    for (slm_elem_t *elem = (col)->first; (elem); (elem) = (elem)->next_row)
+    for (slm_elem_t *elem = slm_elem_at((col)->arena, (col)->first); (elem); (elem) = slm_elem_at((col)->arena, (elem)->next_row))
 
 #define for_each_stack_element_in_row(elem, row) \
-    for (elem = (row)->first; (elem); (elem) = (elem)->next_col)
+    for (elem = slm_elem_at((row)->arena, (row)->first); (elem); (elem) = slm_elem_at((row)->arena, (elem)->next_col))
 
 #define for_each_stack_element_in_col(elem, col) \
-    for (elem = (col)->first; (elem); (elem) = (elem)->next_row)
+    for (elem = slm_elem_at((col)->arena, (col)->first); (elem); (elem) = slm_elem_at((col)->arena, (elem)->next_row))
@@ -0,0 +1,703 @@
+// Checks of the library against brute-force and dense references
+//
+//   make check
+//
+// Builds with AddressSanitizer and UndefinedBehaviorSanitizer, reports every failed check, and exits nonzero if any failed
+
+#include "slm.h"
+#include <unistd.h>
+
+// Side of the dense references, which bounds every row and column number drawn
+#define SIDE 48
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t failures;
+
+// Report a failed check without stopping, so one run lists every failure
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// Dense reference of a matrix, one flag per row and column number below `SIDE`
+typedef struct dense_t {
+    bool at[SIDE][SIDE];
+} dense_t;
+
+// Fill `matrix` and `dense` alike with about `nnz` random elements below row `m` and column `n`
+static void fill(slm_matrix_t *matrix, dense_t *dense, size_t m, size_t n, size_t nnz)
+{
+    for (size_t k = 0; k < nnz; k++) {
+        const size_t i = rng() % m;
+        const size_t j = rng() % n;
+        slm_matrix_insert(matrix, i, j);
+        dense->at[i][j] = true;
+    }
+}
+
+// Check that `matrix` holds exactly the elements of `dense`, with every list ordered, linked both
+// ways, and of the recorded length, and with no empty row or column
+static void check_same(const slm_matrix_t *matrix, const dense_t *dense)
+{
+    size_t nnz = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+    for (size_t i = 0; i < SIDE; i++) {
+        bool any = false;
+        for (size_t j = 0; j < SIDE; j++) {
+            nnz += dense->at[i][j];
+            any |= dense->at[i][j];
+            CHECK(slm_matrix_contains(matrix, i, j) == dense->at[i][j]);
+        }
+        rows += any;
+    }
+    for (size_t j = 0; j < SIDE; j++) {
+        bool any = false;
+        for (size_t i = 0; i < SIDE; i++) {
+            any |= dense->at[i][j];
+        }
+        cols += any;
+    }
+    CHECK(slm_total_elements(matrix) == nnz);
+    CHECK(matrix->m == rows);
+    CHECK(matrix->n == cols);
+
+    const slm_vec_t *prev_row = NULL;
+    for_each_row_in_matrix(row, matrix) {
+        CHECK(!prev_row || (prev_row->index < row->index));
+        CHECK(slm_get_row(matrix, row->index) == row);
+        CHECK(row->length > 0);
+        size_t length = 0;
+        const slm_elem_t *prev = NULL;
+        for_each_element_in_row(elem, row) {
+            CHECK(elem->i == row->index);
+            CHECK(!prev || (prev->j < elem->j));
+            CHECK(slm_elem_at(matrix->arena, elem->prev_col) == prev);
+            prev = elem;
+            length++;
+        }
+        CHECK(length == row->length);
+        prev_row = row;
+    }
+
+    const slm_vec_t *prev_col = NULL;
+    for_each_col_in_matrix(col, matrix) {
+        CHECK(!prev_col || (prev_col->index < col->index));
+        CHECK(slm_get_col(matrix, col->index) == col);
+        CHECK(col->length > 0);
+        size_t length = 0;
+        const slm_elem_t *prev = NULL;
+        for_each_element_in_col(elem, col) {
+            CHECK(elem->j == col->index);
+            CHECK(!prev || (prev->i < elem->i));
+            CHECK(slm_elem_at(matrix->arena, elem->prev_row) == prev);
+            prev = elem;
+            length++;
+        }
+        CHECK(length == col->length);
+        prev_col = col;
+    }
+}
+
+// Size of a maximum matching of the rows below `m` of `dense` into columns outside `used`, tried exhaustively
+static size_t brute_matching(const dense_t *dense, size_t r, size_t m, size_t n, uint64_t used)
+{
+    if (r == m) {
+        return 0;
+    }
+    size_t best = brute_matching(dense, r + 1, m, n, used);
+    for (size_t j = 0; j < n; j++) {
+        if (dense->at[r][j] && !(used >> j & 1)) {
+            const size_t size = 1 + brute_matching(dense, r + 1, m, n, used | (uint64_t)1 << j);
+            best = size > best ? size : best;
+        }
+    }
+    return best;
+}
+
+// Check that the matching `row_match` / `col_match` of `frozen`, of `size` pairs, pairs rows and columns
+// both ways through elements of `frozen`
+static void check_matching(const slm_frozen_t *frozen, const size_t *row_match, const size_t *col_match, size_t size)
+{
+    size_t pairs = 0;
+    for (size_t r = 0; r < frozen->m; r++) {
+        const size_t c = row_match[r];
+        if (c == SLM_UNMATCHED) {
+            continue;
+        }
+        pairs++;
+        CHECK(col_match[c] == r);
+        bool found = false;
+        for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+            found |= frozen->row_elems[e] == c;
+        }
+        CHECK(found);
+    }
+    for (size_t c = 0; c < frozen->n; c++) {
+        CHECK((col_match[c] == SLM_UNMATCHED) || (row_match[col_match[c]] == c));
+    }
+    CHECK(pairs == size);
+}
+
+// Check the permutations, block order, coarse parts, and irreducible square blocks of `dm`, decomposing `frozen`
+static void check_dmperm(const slm_frozen_t *frozen, const slm_dm_t *dm)
+{
+    const size_t m = frozen->m;
+    const size_t n = frozen->n;
+    CHECK((dm->m == m) && (dm->n == n));
+    size_t *row_block = malloc((m + 1) * sizeof(size_t));
+    size_t *col_block = malloc((n + 1) * sizeof(size_t));
+    for (size_t r = 0; r < m; r++) {
+        row_block[r] = SIZE_MAX;
+    }
+    for (size_t c = 0; c < n; c++) {
+        col_block[c] = SIZE_MAX;
+    }
+
+    // Each row and column lies in exactly one nonempty block
+    CHECK((dm->row_ptr[0] == 0) && (dm->row_ptr[dm->count] == m));
+    CHECK((dm->col_ptr[0] == 0) && (dm->col_ptr[dm->count] == n));
+    for (size_t b = 0; b < dm->count; b++) {
+        CHECK((dm->row_ptr[b] <= dm->row_ptr[b + 1]) && (dm->col_ptr[b] <= dm->col_ptr[b + 1]));
+        CHECK((dm->row_ptr[b] < dm->row_ptr[b + 1]) || (dm->col_ptr[b] < dm->col_ptr[b + 1]));
+        for (size_t k = dm->row_ptr[b]; k < dm->row_ptr[b + 1]; k++) {
+            CHECK(row_block[dm->row_perm[k]] == SIZE_MAX);
+            row_block[dm->row_perm[k]] = b;
+        }
+        for (size_t k = dm->col_ptr[b]; k < dm->col_ptr[b + 1]; k++) {
+            CHECK(col_block[dm->col_perm[k]] == SIZE_MAX);
+            col_block[dm->col_perm[k]] = b;
+        }
+    }
+
+    // Block upper triangular: no element lies left of its row's block
+    for (size_t r = 0; r < m; r++) {
+        for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+            CHECK(row_block[r] <= col_block[frozen->row_elems[e]]);
+        }
+    }
+
+    // The coarse parts match up in size, and the unmatched rows and columns are the ones the rank leaves over
+    CHECK((dm->row_coarse[0] == 0) && (dm->row_coarse[4] == m));
+    CHECK((dm->col_coarse[0] == 0) && (dm->col_coarse[4] == n));
+    CHECK(dm->col_coarse[2] - dm->col_coarse[1] == dm->row_coarse[1]);
+    CHECK(dm->col_coarse[3] - dm->col_coarse[2] == dm->row_coarse[2] - dm->row_coarse[1]);
+    CHECK(dm->col_coarse[4] - dm->col_coarse[3] == dm->row_coarse[3] - dm->row_coarse[2]);
+    CHECK(dm->row_coarse[4] - dm->row_coarse[3] == m - dm->rank);
+    CHECK(dm->col_coarse[1] == n - dm->rank);
+
+    // Square blocks are square, matched along their diagonal, and strongly connected through the matching
+    size_t *queue = malloc((m + 1) * sizeof(size_t));
+    bool *seen = malloc(m + 1);
+    for (size_t b = 0; b < dm->count; b++) {
+        const size_t r0 = dm->row_ptr[b];
+        const size_t r1 = dm->row_ptr[b + 1];
+        if ((r0 < dm->row_coarse[1]) || (r0 >= dm->row_coarse[2])) {
+            continue;
+        }
+        CHECK(r1 - r0 == dm->col_ptr[b + 1] - dm->col_ptr[b]);
+        for (size_t k = 0; k < r1 - r0; k++) {
+            CHECK(dm->row_match[dm->row_perm[r0 + k]] == dm->col_perm[dm->col_ptr[b] + k]);
+        }
+        for (int forward = 0; forward < 2; forward++) {
+            memset(seen, 0, m + 1);
+            size_t head = 0;
+            size_t tail = 0;
+            queue[tail++] = dm->row_perm[r0];
+            seen[dm->row_perm[r0]] = true;
+            while (head < tail) {
+                const size_t r = queue[head++];
+                if (forward) {
+                    for (size_t e = frozen->row_ptr[r]; e < frozen->row_ptr[r + 1]; e++) {
+                        const size_t c = frozen->row_elems[e];
+                        const size_t w = dm->col_match[c];
+                        if ((col_block[c] == b) && !seen[w]) {
+                            seen[w] = true;
+                            queue[tail++] = w;
+                        }
+                    }
+                }
+                else {
+                    const size_t c = dm->row_match[r];
+                    for (size_t e = frozen->col_ptr[c]; e < frozen->col_ptr[c + 1]; e++) {
+                        const size_t w = frozen->col_elems[e];
+                        if ((row_block[w] == b) && !seen[w]) {
+                            seen[w] = true;
+                            queue[tail++] = w;
+                        }
+                    }
+                }
+            }
+            CHECK(tail == r1 - r0);
+        }
+    }
+    free(seen);
+    free(queue);
+    free(col_block);
+    free(row_block);
+}
+
+// Hopcroft-Karp against exhaustive search on small matrices, then the decomposition built on it
+static void test_matching(void)
+{
+    for (int round = 0; round < 2000; round++) {
+        const size_t m = 1 + rng() % 8;
+        const size_t n = 1 + rng() % 8;
+        dense_t dense = { 0 };
+        slm_matrix_t *matrix = slm_matrix_new();
+        fill(matrix, &dense, m, n, rng() % (m * n + 1));
+
+        slm_frozen_t *frozen = slm_matrix_freeze(matrix);
+        size_t *row_match = malloc((frozen->m + 1) * sizeof(size_t));
+        size_t *col_match = malloc((frozen->n + 1) * sizeof(size_t));
+        const size_t size = slm_frozen_matching(frozen, row_match, col_match);
+        CHECK(size == brute_matching(&dense, 0, m, n, 0));
+        check_matching(frozen, row_match, col_match, size);
+
+        slm_dm_t *dm = slm_frozen_dmperm(frozen);
+        CHECK(dm->rank == size);
+        check_matching(frozen, dm->row_match, dm->col_match, dm->rank);
+        check_dmperm(frozen, dm);
+        slm_dm_free(dm);
+
+        free(col_match);
+        free(row_match);
+        slm_frozen_free(frozen);
+        slm_matrix_free(matrix);
+    }
+
+    // Larger and more structured matrices, against the decomposition invariants alone
+    for (int round = 0; round < 200; round++) {
+        dense_t dense = { 0 };
+        slm_matrix_t *matrix = slm_matrix_new();
+        fill(matrix, &dense, SIDE, SIDE, rng() % (4 * SIDE));
+        for (size_t k = 0; k < SIDE; k += 1 + round % 3) {
+            slm_matrix_insert(matrix, k, k);
+        }
+        slm_frozen_t *frozen = slm_matrix_freeze(matrix);
+        slm_dm_t *dm = slm_frozen_dmperm(frozen);
+        check_dmperm(frozen, dm);
+        slm_dm_free(dm);
+        slm_frozen_free(frozen);
+        slm_matrix_free(matrix);
+    }
+}
+
+// Write `matrix` in `format` to the file `path`
+static bool write_file(const char *path, const slm_matrix_t *matrix, slm_format_t format, size_t threads)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    const bool ok = slm_matrix_write(f, matrix, format, threads);
+    return (fclose(f) == 0) && ok;
+}
+
+// Read back the grid of `SLM_FORMAT_DENSE`, whose columns are those of `matrix` in order
+static bool read_dense(const char *path, const slm_matrix_t *matrix, dense_t *dense)
+{
+    size_t cols[SIDE];
+    size_t n = 0;
+    for_each_col_in_matrix(col, matrix) {
+        cols[n++] = col->index;
+    }
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    size_t rows = 0;
+    size_t width = 0;
+    bool ok = (matrix->m == 0) || (fscanf(f, "%zu rows by %zu cols", &rows, &width) == 2);
+    ok = ok && (rows == matrix->m) && (width == n);
+    for (size_t r = 0; ok && (r < rows); r++) {
+        size_t i = 0;
+        char line[SIDE + 1];
+        ok = (fscanf(f, "%zu %48s", &i, line) == 2) && (i < SIDE) && (strlen(line) == n);
+        for (size_t c = 0; ok && (c < n); c++) {
+            ok = (line[c] == '1') || (line[c] == '-');
+            dense->at[i][cols[c]] = line[c] == '1';
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Read back the row pointers and column indices of `SLM_FORMAT_CSR`
+static bool read_csr(const char *path, dense_t *dense)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    size_t m = 0;
+    size_t n = 0;
+    size_t nnz = 0;
+    bool ok = (fscanf(f, "%zu %zu %zu", &m, &n, &nnz) == 3) && (m <= SIDE) && (n <= SIDE);
+    size_t ptr[SIDE + 1] = { 0 };
+    for (size_t r = 0; ok && (r <= m); r++) {
+        ok = (fscanf(f, "%zu", &ptr[r]) == 1) && (!r || (ptr[r - 1] <= ptr[r]));
+    }
+    ok = ok && (ptr[0] == 0) && (ptr[m] == nnz);
+    for (size_t r = 0; ok && (r < m); r++) {
+        for (size_t k = ptr[r]; ok && (k < ptr[r + 1]); k++) {
+            size_t j = 0;
+            ok = (fscanf(f, "%zu", &j) == 1) && (j < n);
+            if (ok) {
+                dense->at[r][j] = true;
+            }
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Every text format and the binary snapshot format, written and read back
+static void test_formats(void)
+{
+    char path[] = "/tmp/slm_test_XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+
+    for (int round = 0; round < 60; round++) {
+        dense_t dense = { 0 };
+        slm_matrix_t *matrix = slm_matrix_new();
+        fill(matrix, &dense, 1 + rng() % SIDE, 1 + rng() % SIDE, rng() % (SIDE * SIDE / 4));
+        const size_t threads = 1 + round % 4;
+
+        CHECK(write_file(path, matrix, SLM_FORMAT_MTX, threads));
+        slm_matrix_t *read = slm_matrix_read_mtx(path, threads);
+        CHECK(read);
+        if (read) {
+            check_same(read, &dense);
+            slm_matrix_free(read);
+        }
+
+        CHECK(write_file(path, matrix, SLM_FORMAT_EDGES, threads));
+        read = slm_matrix_read_edges(path, threads);
+        CHECK(read);
+        if (read) {
+            check_same(read, &dense);
+            slm_matrix_free(read);
+        }
+
+        dense_t back = { 0 };
+        CHECK(write_file(path, matrix, SLM_FORMAT_DENSE, threads));
+        CHECK(read_dense(path, matrix, &back));
+        CHECK(!memcmp(&back, &dense, sizeof(dense_t)));
+
+        memset(&back, 0, sizeof(dense_t));
+        CHECK(write_file(path, matrix, SLM_FORMAT_CSR, threads));
+        CHECK(read_csr(path, &back));
+        CHECK(!memcmp(&back, &dense, sizeof(dense_t)));
+
+        CHECK(slm_matrix_save(matrix, path));
+        slm_frozen_t *mapped = slm_matrix_map(path);
+        CHECK(mapped);
+        if (mapped) {
+            slm_matrix_t *thawed = slm_matrix_thaw(mapped);
+            check_same(thawed, &dense);
+            slm_matrix_free(thawed);
+            slm_frozen_free(mapped);
+        }
+        slm_matrix_free(matrix);
+    }
+
+    // A Matrix Market file promising more entries than it holds is rejected
+    FILE *f = fopen(path, "w");
+    CHECK(f);
+    if (f) {
+        fputs("%%MatrixMarket matrix coordinate pattern general\n3 3 2\n1 1\n", f);
+        fclose(f);
+        CHECK(!slm_matrix_read_mtx(path, 2));
+    }
+    unlink(path);
+}
+
+static bool setop(slm_setop_t op, bool a, bool b)
+{
+    switch (op) {
+        case SLM_SETOP_OR:
+            return a || b;
+        case SLM_SETOP_AND:
+            return a && b;
+        case SLM_SETOP_XOR:
+            return a != b;
+        case SLM_SETOP_ANDNOT:
+            return a && !b;
+    }
+    return false;
+}
+
+// Set operations, both producing a new matrix and in place, against the dense reference
+static void test_setops(void)
+{
+    static void (*const inplace[])(slm_matrix_t *, const slm_matrix_t *) = {
+        [SLM_SETOP_OR] = slm_matrix_or_inplace,
+        [SLM_SETOP_AND] = slm_matrix_and_inplace,
+        [SLM_SETOP_XOR] = slm_matrix_xor_inplace,
+        [SLM_SETOP_ANDNOT] = slm_matrix_andnot_inplace
+    };
+    for (int round = 0; round < 40; round++) {
+        dense_t a = { 0 };
+        dense_t b = { 0 };
+        slm_matrix_t *A = slm_matrix_new();
+        slm_matrix_t *B = slm_matrix_new();
+        // Some rounds crowd a few rows, so that their dense indexes come into play in the `test_slm_dense` build
+        const size_t side = 1 + rng() % SIDE;
+        fill(A, &a, round % 2 ? 4 : side, side, rng() % (side * side));
+        fill(B, &b, side, side, rng() % (side * side));
+        if (round % 3 == 0) {
+            slm_matrix_index(A);
+        }
+
+        for (slm_setop_t op = SLM_SETOP_OR; op <= SLM_SETOP_ANDNOT; op++) {
+            dense_t want = { 0 };
+            for (size_t i = 0; i < SIDE; i++) {
+                for (size_t j = 0; j < SIDE; j++) {
+                    want.at[i][j] = setop(op, a.at[i][j], b.at[i][j]);
+                }
+            }
+            slm_matrix_t *R = slm_matrix_combine_parallel(A, B, op, 1 + round % 3);
+            check_same(R, &want);
+            slm_matrix_free(R);
+
+            R = slm_matrix_dupl(A);
+            if (round % 4 == 0) {
+                slm_matrix_track_components(R);
+            }
+            inplace[op](R, B);
+            check_same(R, &want);
+            slm_matrix_free(R);
+
+            // An operand combined with itself
+            for (size_t i = 0; i < SIDE; i++) {
+                for (size_t j = 0; j < SIDE; j++) {
+                    want.at[i][j] = setop(op, a.at[i][j], a.at[i][j]);
+                }
+            }
+            R = slm_matrix_dupl(A);
+            inplace[op](R, R);
+            check_same(R, &want);
+            slm_matrix_free(R);
+        }
+        slm_matrix_free(A);
+        slm_matrix_free(B);
+    }
+}
+
+// Check that snapshot `snapshot` holds exactly the elements of `dense`
+static void check_snapshot(const slm_snapshot_t *snapshot, const dense_t *dense)
+{
+    size_t nnz = 0;
+    for (size_t i = 0; i < SIDE; i++) {
+        size_t length = 0;
+        const slm_index_t *cols = slm_snapshot_row(snapshot, i, &length);
+        size_t k = 0;
+        for (size_t j = 0; j < SIDE; j++) {
+            CHECK(slm_snapshot_contains(snapshot, i, j) == dense->at[i][j]);
+            if (dense->at[i][j]) {
+                CHECK(cols && (k < length) && (cols[k] == j));
+                k++;
+            }
+        }
+        CHECK(k == length);
+        nnz += length;
+    }
+    CHECK(slm_snapshot_total_elements(snapshot) == nnz);
+}
+
+// Snapshots keep the elements of their time through every kind of later change to the matrix
+static void test_snapshots(void)
+{
+    enum { KEPT = 8 };
+    slm_snapshot_t *kept[KEPT] = { 0 };
+    dense_t *then = calloc(KEPT, sizeof(dense_t));
+    dense_t now = { 0 };
+    slm_matrix_t *matrix = slm_matrix_new();
+    for (int round = 0; round < 200; round++) {
+        switch (rng() % 6) {
+            case 0:
+            case 1:
+                fill(matrix, &now, SIDE, SIDE, 20);
+                break;
+            case 2: {
+                const size_t i = rng() % SIDE;
+                slm_matrix_remove_row(matrix, i);
+                memset(now.at[i], 0, sizeof(now.at[i]));
+                break;
+            }
+            case 3: {
+                const size_t j = rng() % SIDE;
+                slm_matrix_remove_col(matrix, j);
+                for (size_t i = 0; i < SIDE; i++) {
+                    now.at[i][j] = false;
+                }
+                break;
+            }
+            case 4: {
+                dense_t other = { 0 };
+                slm_matrix_t *B = slm_matrix_new();
+                fill(B, &other, SIDE, SIDE, 200);
+                slm_matrix_xor_inplace(matrix, B);
+                for (size_t i = 0; i < SIDE; i++) {
+                    for (size_t j = 0; j < SIDE; j++) {
+                        now.at[i][j] ^= other.at[i][j];
+                    }
+                }
+                slm_matrix_free(B);
+                break;
+            }
+            case 5: {
+                slm_matrix_transpose_inplace(matrix);
+                const dense_t before = now;
+                for (size_t i = 0; i < SIDE; i++) {
+                    for (size_t j = 0; j < SIDE; j++) {
+                        now.at[i][j] = before.at[j][i];
+                    }
+                }
+                break;
+            }
+        }
+
+        // Replace one kept snapshot, after checking that it is unchanged
+        const size_t k = rng() % KEPT;
+        if (kept[k]) {
+            check_snapshot(kept[k], &then[k]);
+            slm_snapshot_release(kept[k]);
+        }
+        kept[k] = slm_matrix_snapshot(matrix);
+        then[k] = now;
+        check_snapshot(kept[k], &now);
+    }
+    for (size_t k = 0; k < KEPT; k++) {
+        if (kept[k]) {
+            check_snapshot(kept[k], &then[k]);
+            slm_snapshot_release(kept[k]);
+        }
+    }
+    check_same(matrix, &now);
+    slm_matrix_free(matrix);
+    free(then);
+}
+
+// Check that the labelings `a` and `b` place rows and columns in the same blocks
+static void check_same_blocks(const slm_blocks_t *a, const slm_blocks_t *b)
+{
+    CHECK((a->count == b->count) && (a->m == b->m) && (a->n == b->n));
+    if ((a->m != b->m) || (a->n != b->n)) {
+        return;
+    }
+    CHECK(!memcmp(a->row_block, b->row_block, a->m * sizeof(size_t)));
+    CHECK(!memcmp(a->col_block, b->col_block, a->n * sizeof(size_t)));
+}
+
+// Tracked components follow inserts and removals, agreeing with blocks found by searching a copy
+static void test_components(void)
+{
+    for (int round = 0; round < 30; round++) {
+        const size_t side = 2 + rng() % SIDE;
+        slm_matrix_t *matrix = slm_matrix_new();
+        slm_matrix_track_components(matrix);
+        for (int step = 0; step < 400; step++) {
+            switch (rng() % 8) {
+                case 0:
+                    slm_matrix_remove_row(matrix, rng() % side);
+                    break;
+                case 1:
+                    slm_matrix_remove_col(matrix, rng() % side);
+                    break;
+                case 2: {
+                    size_t i[4];
+                    size_t j[4];
+                    for (size_t k = 0; k < 4; k++) {
+                        i[k] = rng() % side;
+                        j[k] = rng() % side;
+                    }
+                    slm_matrix_insert_coo(matrix, i, j, 4);
+                    break;
+                }
+                default:
+                    slm_matrix_insert(matrix, rng() % side, rng() % side);
+                    break;
+            }
+            if (step % 20) {
+                continue;
+            }
+
+            slm_matrix_t *copy = slm_matrix_new();
+            for_each_row_in_matrix(row, matrix) {
+                for_each_element_in_row(elem, row) {
+                    slm_matrix_insert(copy, elem->i, elem->j);
+                }
+            }
+            slm_blocks_t *want = slm_matrix_blocks(copy);
+            CHECK(slm_matrix_component_count(matrix) == want->count);
+            slm_blocks_t *got = slm_matrix_blocks(matrix);
+            check_same_blocks(got, want);
+            slm_blocks_free(got);
+            slm_blocks_free(want);
+            slm_matrix_free(copy);
+        }
+        slm_matrix_free(matrix);
+    }
+}
+
+// Deferred inserts are merged before any read, and a bulk insert over several threads matches one over a single thread
+static void test_inserts(void)
+{
+    for (int round = 0; round < 20; round++) {
+        dense_t dense = { 0 };
+        slm_matrix_t *matrix = slm_matrix_new();
+        slm_matrix_defer(matrix, true);
+        fill(matrix, &dense, SIDE, SIDE, rng() % (SIDE * SIDE));
+        check_same(matrix, &dense);
+
+        enum { COUNT = 4 * SIDE * SIDE };
+        size_t *i = malloc(COUNT * sizeof(size_t));
+        size_t *j = malloc(COUNT * sizeof(size_t));
+        for (size_t k = 0; k < COUNT; k++) {
+            i[k] = rng() % SIDE;
+            j[k] = rng() % (round % 2 ? SIDE : 8);
+            dense.at[i[k]][j[k]] = true;
+        }
+        slm_matrix_insert_coo_parallel(matrix, i, j, COUNT / 2, 1 + round % 4);
+        slm_matrix_insert_coo_parallel(matrix, i + COUNT / 2, j + COUNT / 2, COUNT / 2, 1);
+        check_same(matrix, &dense);
+        free(j);
+        free(i);
+        slm_matrix_free(matrix);
+    }
+}
+
+int main(void)
+{
+    test_matching();
+    test_formats();
+    test_setops();
+    test_snapshots();
+    test_components();
+    test_inserts();
+    if (failures) {
+        fprintf(stderr, "%zu checks failed\n", failures);
+        return 1;
+    }
+    puts("all checks passed");
+    return 0;
+}